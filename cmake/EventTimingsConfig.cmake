@@ -1,5 +1,6 @@
 include(CMakeFindDependencyMacro)
 
 find_dependency(MPI)
+find_dependency(Threads)
 
 include("${CMAKE_CURRENT_LIST_DIR}/EventTimingsTargets.cmake")
@@ -75,6 +75,8 @@ def normalize_times(*args):
         for ranks in d["Ranks"]:
             for sc in ranks["StateChanges"]:
                 sc["Timestamp"] = int(sc["Timestamp"] + (delta.total_seconds() * 1000))
+            for counter in ranks.get("Counters", {}).values():
+                counter["Timestamps"] = [t + delta.total_seconds() * 1000 for t in counter["Timestamps"]]
                 
     return args
 
@@ -128,10 +130,11 @@ def main():
                 continue
             traces.append(build_thread_name_entry("Rank {:4d}".format(rank), pid, rank))
             
+            # State changes are sorted by time, so the events are emitted in order
             for sc in rank_data["StateChanges"]:
-                if args.noglobal and sc["Name"] == "_GLOBAL":
-                    continue
                 if args.maxtime > -1 and sc["Timestamp"] > args.maxtime:
+                    break
+                if args.noglobal and sc["Name"] == "_GLOBAL":
                     continue
 
                 # The current log format contains begin and end timestamps of
@@ -146,6 +149,20 @@ def main():
                 }
                 traces.append(event)
 
+            # Counters are shown as counter tracks of the participant, one per rank
+            for name, counter in rank_data.get("Counters", {}).items():
+                for timestamp, value in zip(counter["Timestamps"], counter["Values"]):
+                    if args.maxtime > -1 and timestamp > args.maxtime:
+                        continue
+                    traces.append({
+                        "name": name,
+                        "id": rank,
+                        "pid": pid,
+                        "ts": timestamp * 1000, # convert from ms to µs
+                        "ph": "C",
+                        "args": {name: value}
+                    })
+
     if args.pretty:
         print(json.dumps(traces, indent=2))
     else:
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+
+namespace EventTimings {
+
+/// Layout of the binary event log, see docs/LogFormat.md.
+/** A log is a sequence of blocks, one per rank, each starting with a Header. All offsets are in bytes from the start
+of the block and all sections are aligned to 8 bytes, so a mapped log can be read in place. As blocks are
+self-contained, the per-rank files appName-events.rank<N>.bin can be concatenated to a log of all ranks.
+Values are in the byte order of the machine that wrote them.
+
+Times of state changes and counters are ticks of the steady clock in nanoseconds, not normalized, i.e., they are
+converted to times since the first rank initialized by RankData::normalizeTo when the log is read.
+
+The state changes are also written as intervals, indexed by time for each rank and for each event, see Checkpoint. */
+namespace binary {
+
+constexpr char magic[8] = {'E', 'T', 'E', 'V', 'E', 'N', 'T', 'S'};
+constexpr std::uint32_t version = 3;
+
+/// Number of positions of an index of intervals between two checkpoints
+constexpr std::uint32_t checkpointInterval = 64;
+
+/// A string in the string table of the block, not terminated
+struct String
+{
+  std::uint64_t offset, length;
+};
+
+/// A range of entries of a section, as index of the first entry and number of entries
+struct Range
+{
+  std::uint64_t first, size;
+};
+
+/// A section of the block
+struct Section
+{
+  std::uint64_t offset, size;
+};
+
+struct Header
+{
+  char magic[8];
+  std::uint32_t version;
+  std::int32_t rank;
+
+  /// Size of the block including this header, the next block starts at this offset
+  std::uint64_t blockSize;
+
+  /// System clock in nanoseconds since the epoch
+  std::int64_t initializedAt, finalizedAt;
+
+  /// Steady clock at initialize in nanoseconds, the origin of the state changes, see RankData::normalizeTo
+  std::int64_t initializedAtTicks;
+
+  /// Estimated cost of a transition in nanoseconds, see RankData::transitionCost
+  double transitionCost;
+  std::uint32_t compensated;
+
+  /// Number of positions between two checkpoints of the indices of intervals
+  std::uint32_t checkpointInterval;
+
+  /// Size of strings in bytes, sizes of the other sections in entries
+  Section strings, events, stateChanges, dataKeys, dataValues, metrics, sent, nodes, counters, samples, decisions;
+  Section intervals, timeline, checkpoints, open;
+
+  /// Range of checkpoints of the timeline
+  Range timelineCheckpoints;
+};
+
+/// Timings of an event, durations in nanoseconds
+struct Event
+{
+  String name;
+  std::int64_t count, total, max, min, transitions, untraced;
+  std::uint32_t throttled;
+  std::uint32_t reserved;
+  Range stateChanges, dataKeys, metrics, sent;
+
+  /// Range of intervals of the event, sorted by start, and range of their checkpoints
+  Range intervals, checkpoints;
+};
+
+struct StateChange
+{
+  std::int64_t timestamp;
+  std::int32_t state; ///< Event::State
+  std::int32_t thread; ///< Index of the thread within the rank
+};
+
+/// Data of an event with the given key, see Event::addData
+struct DataKey
+{
+  String key;
+  Range values; ///< Range of dataValues, which are int32
+};
+
+struct Metric
+{
+  String name;
+  double value;
+};
+
+struct Sent
+{
+  std::int64_t peer, bytes, messages;
+};
+
+/// Node of the call tree, the root first and parents before their children
+struct Node
+{
+  String name;
+  std::int64_t parent, count, inclusive, transitions;
+};
+
+struct Counter
+{
+  String name;
+  Range samples;
+};
+
+struct Sample
+{
+  std::int64_t timestamp;
+  double value;
+};
+
+struct Decision
+{
+  double time, overhead;
+  String action, subject;
+};
+
+/// Time in which an event ran, from a start or resume to the next pause or stop of the same thread, in ticks like StateChange
+/** Intervals are grouped by event and sorted by start, longer intervals first if they start at the same time. The
+timeline holds the indices of all intervals of the block, sorted the same way. */
+struct Interval
+{
+  std::int64_t start, stop;
+  std::uint64_t event; ///< Index of the event in the events of the block
+};
+
+/// Intervals, that overlap the start of an interval of an index, but started before it.
+/** An index, i.e., the timeline or the intervals of an event, has a checkpoint at every checkpointInterval-th
+position. The checkpoint holds the range of open, the indices of the intervals, which are at earlier positions of the
+index and stop at or after the start of the interval at its position, sorted by position. So the intervals overlapping
+a time range are found by a binary search for its begin, the checkpoint before and at most checkpointInterval
+positions, in O(log n + k) for a bounded nesting of the intervals. */
+struct Checkpoint
+{
+  Range open;
+};
+
+}
+}
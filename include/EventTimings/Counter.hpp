@@ -0,0 +1,74 @@
+#pragma once
+
+#include "EventTimings/Event.hpp"
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace EventTimings {
+
+/// Time series of a counter, stored columnar
+struct CounterSeries
+{
+  /// Ticks of the steady clock of the samples, after normalize nanoseconds since the first rank initialized
+  std::vector<Event::Clock::rep> timestamps;
+
+  std::vector<double> values;
+};
+
+/// Records timestamped values of a quantity, e.g., a residual, a queue depth or the number of active cells.
+/** Unlike data of events, values are not bound to a running event, but form a time series per rank,
+that lines up with the timeline of the events. Get a counter by EventRegistry::counter.
+
+The number of stored samples is bounded by the capacity. When it is exceeded, pairs of adjacent samples are
+averaged into one and from then on, twice as many values are averaged into each sample.
+So a counter keeps the shape of the whole run at a decreasing resolution. Recording is thread-safe. */
+class Counter
+{
+public:
+  /// Default maximum number of samples of a counter
+  static constexpr size_t defaultCapacity = 1 << 16;
+
+  explicit Counter(std::string name, size_t capacity = defaultCapacity);
+
+  Counter(Counter const &) = delete;
+
+  /// Records a value at the current time
+  void record(double value);
+
+  /// Sets the maximum number of samples, 0 stores all samples without downsampling.
+  /** Reducing the capacity below the number of samples downsamples immediately. */
+  void setCapacity(size_t capacity);
+
+  std::string const & getName() const;
+
+  /// Returns the samples, including the average of the values, that do not yet fill a sample
+  CounterSeries getSeries() const;
+
+  /// Removes all samples and resets the downsampling
+  void clear();
+
+private:
+  /// Halves the number of samples by averaging adjacent pairs, must be called with mutex locked.
+  /** An odd last sample becomes part of the pending sample. */
+  void downsample();
+
+  std::string name;
+
+  size_t capacity;
+
+  mutable std::mutex mutex;
+
+  CounterSeries series;
+
+  /// Number of values averaged into one sample, doubled by each downsample
+  long stride = 1;
+
+  /// Values of the sample, that is not yet stored
+  long pendingCount = 0;
+  double pendingSum = 0;
+  Event::Clock::rep pendingTimestamp = 0;
+};
+
+}
@@ -1,16 +1,178 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <limits>
+#include <memory>
 #include <vector>
 #include <string>
 #include <map>
 
 namespace EventTimings {
 
+namespace detail {
+
+/// Transition of an event, as recorded in the thread-local buffer.
+enum class Transition : int {
+  Start      = 0, ///< Started from stopped
+  Resume     = 1, ///< Started from paused
+  Pause      = 2,
+  Stop       = 3, ///< Stopped from started
+  StopPaused = 4, ///< Stopped from paused
+  Given      = 5, ///< Event with a given duration, that was never started
+};
+
+/// A single transition of an event.
+struct Record
+{
+  int id;
+  Transition transition;
+
+  /// Ticks of the steady clock at the transition
+  std::chrono::steady_clock::rep timestamp;
+
+  /// Duration of the event instance, only set for Stop, StopPaused and Given
+  std::chrono::steady_clock::rep duration;
+};
+
+/// Sums of the calls of a call slot while an event ran, see EventRegistry::putCall
+struct CallSums
+{
+  long long calls = 0, bytes = 0, nanoseconds = 0;
+};
+
+/// Sums of the messages sent to a peer while an event ran, see EventRegistry::putMessage
+struct MessageSums
+{
+  long long messages = 0, bytes = 0;
+};
+
+/// Sums of the allocations and frees while an event ran, see countAllocation
+struct MemorySums
+{
+  long long allocations = 0, allocated = 0, frees = 0, freed = 0;
+};
+
+/// Fixed-size buffer of the records of one thread.
+/** Records are appended in the fast path. When the buffer is full, the records are replayed
+into the EventRegistry and the buffer is emptied. */
+struct Buffer
+{
+  static constexpr int capacity = 4096;
+
+  /// Maximum nesting depth of running events, that is tracked
+  static constexpr int maxDepth = 64;
+
+  /// Index of the thread that owns this buffer within the EventRegistry
+  int thread = 0;
+
+  int size = 0;
+
+  /// Number of running events, may exceed maxDepth
+  int depth = 0;
+
+  /// Ticks of the steady clock, after which the next stop flushes the buffer, see poll.
+  /** Set by the EventRegistry, zero flushes at the next stop. */
+  std::atomic<std::chrono::steady_clock::rep> flushAt{std::numeric_limits<std::chrono::steady_clock::rep>::max()};
+
+  /// Ids of the running events of the thread, innermost last
+  int running[maxDepth];
+
+  Record records[capacity];
+
+  /// Number of slots of the sample ring
+  static constexpr unsigned sampleCapacity = 1 << 15;
+
+  /// Positions of the sample ring, written by the signal handler of the sampler (head) and when flushing (tail)
+  std::atomic<unsigned> sampleHead{0}, sampleTail{0};
+
+  /// Ring of samples of the sampling profiler, each is its number of ids n, the instruction pointer and n ids.
+  /** Allocated once the sampler was started, see EventRegistry::addSampleRing, nullptr before. */
+  std::unique_ptr<long long[]> samples;
+
+  /// Sums of the MPI and I/O calls of the thread, indexed by event id and call slot, added to the metrics on replay
+  std::vector<std::vector<CallSums>> calls;
+
+  /// Messages of the thread, indexed by event id, map of peer -> sums, added to the communication matrix on replay
+  std::vector<std::map<int, MessageSums>> sent;
+
+  /// Allocations of the thread, indexed by event id, added to the metrics on replay
+  std::vector<MemorySums> memory;
+};
+
+/// Buffer of the current thread, nullptr before the first event of the thread was recorded
+extern thread_local Buffer * buffer;
+
+/// Whether probes are read on every transition, see EventRegistry::addProbe
+extern bool probing;
+
+/// Set while allocations and I/O of the thread are not counted, e.g., while counting one or replaying records
+extern thread_local bool untracked;
+
+/// Incremented, whenever event names start or stop being recorded, e.g., by a filter or the overhead budget
+extern std::atomic<unsigned> passingVersion;
+
+/// Registers a buffer for the current thread or flushes its buffer, returns the buffer to use.
+Buffer * overflow();
+
+/// Removes an event, that is not the innermost one, from the running events
+void leaveNested(int id);
+
+/// Flushes the buffer of the current thread, if its deadline passed, so periodic work runs without a full buffer.
+/** Must be called after record. */
+inline void poll(std::chrono::steady_clock::time_point now)
+{
+  if (now.time_since_epoch().count() >= buffer->flushAt.load(std::memory_order_relaxed))
+    overflow();
+}
+
+/// Appends a transition to the buffer of the current thread
+inline void record(int id, Transition transition, std::chrono::steady_clock::time_point timestamp,
+                   std::chrono::steady_clock::duration duration = std::chrono::steady_clock::duration::zero())
+{
+  Buffer * b = buffer;
+  if (b == nullptr or b->size == Buffer::capacity)
+    b = overflow();
+  b->records[b->size++] = {id, transition, timestamp.time_since_epoch().count(), duration.count()};
+}
+
+/// Pushes a started event on the running events, must be called after record
+inline void enter(int id)
+{
+  if (buffer->depth < Buffer::maxDepth)
+    buffer->running[buffer->depth] = id;
+  // The sampler reads the running events in a signal handler, it must not see the depth before the id
+  std::atomic_signal_fence(std::memory_order_release);
+  buffer->depth++;
+}
+
+/// Removes a paused or stopped event from the running events, must be called after record
+inline void leave(int id)
+{
+  int const depth = buffer->depth;
+  if (depth > 0 and depth <= Buffer::maxDepth and buffer->running[depth - 1] == id)
+    buffer->depth--;
+  else
+    leaveNested(id);
+}
+
+/// Returns the id of the innermost running event of the calling thread, -1 if there is none
+inline int runningEvent()
+{
+  if (buffer == nullptr or buffer->depth == 0)
+    return -1;
+  return buffer->running[std::min(buffer->depth, Buffer::maxDepth) - 1];
+}
+
+}
+
 /// Represents an event that can be started and stopped.
 /** Additionally to the duration there is a special property that can be set for a event.
 A property is a a key-value pair with a numerical value that can be used to trace certain events,
-like MPI calls in an event. It is intended to be set by the user. */
+like MPI calls in an event. It is intended to be set by the user.
+
+Starting, pausing and stopping are inlined and only append to a thread-local buffer. */
 class Event
 {
 public:
@@ -59,18 +221,131 @@ public:
   /// Adds named integer data, associated to an event.
   void addData(std::string key, int value);
 
+  /// Gets the id of the event name within the EventRegistry
+  int getId() const;
+
   Data data;
-  
-  StateChanges stateChanges;
 
 private:
+  friend class EventRegistry;
+
+  /// Calls a barrier on the communicator of the EventRegistry and records the time spent in it
+  void synchronize();
+
+  /// Asks the EventRegistry again, whether the event is recorded, after the filter or the shed events changed
+  void updateRecorded();
+
+  /// Passes data to the EventRegistry and clears it
+  void commitData();
+
+  /// Reads the probes at start
+  void startProbes();
+
+  /// Reads the probes at pause or stop and accumulates the differences to the values at start
+  void stopProbes();
+
+  /// Passes the accumulated probe values to the EventRegistry and clears them
+  void commitProbes();
 
   Clock::time_point starttime;
   Clock::duration duration = Clock::duration::zero();
   State state = State::STOPPED;
   bool _barrier = false;
+
+  /// Id of name, as given by EventRegistry::getId
+  int id = -1;
+
+  /// Whether the event is recorded, as decided by EventRegistry::isRecorded, updated by start
+  bool recorded = true;
+
+  /// detail::passingVersion, when recorded was decided
+  unsigned version = 0;
+
+  /// Probe values at the last start and accumulated differences of this instance
+  std::vector<long long> probeStart, probeValues;
 };
 
+inline Event::~Event()
+{
+  stop(_barrier);
+}
+
+inline void Event::start(bool barrier)
+{
+  if (barrier)
+    synchronize();
+
+  if (state == State::STARTED)
+    return;
+  if (version != detail::passingVersion.load(std::memory_order_relaxed))
+    updateRecorded();
+  if (not recorded)
+    return;
+
+  auto const transition = state == State::PAUSED ? detail::Transition::Resume : detail::Transition::Start;
+  state = State::STARTED;
+  starttime = Clock::now();
+  detail::record(id, transition, starttime);
+  detail::enter(id);
+  if (detail::probing)
+    startProbes();
+}
+
+inline void Event::stop(bool barrier)
+{
+  if (state == State::STARTED or state == State::PAUSED) {
+    if (barrier)
+      synchronize();
+
+    if (detail::probing and state == State::STARTED)
+      stopProbes();
+
+    auto stoptime = Clock::now();
+    auto transition = detail::Transition::StopPaused;
+    if (state == State::STARTED) {
+      duration += Clock::duration(stoptime - starttime);
+      transition = detail::Transition::Stop;
+    }
+    detail::record(id, transition, stoptime, duration);
+    if (state == State::STARTED)
+      detail::leave(id);
+    state = State::STOPPED;
+    if (not data.empty())
+      commitData();
+    if (detail::probing)
+      commitProbes();
+    duration = Clock::duration::zero();
+    detail::poll(stoptime);
+  }
+}
+
+inline void Event::pause(bool barrier)
+{
+  if (state == State::STARTED) {
+    if (barrier)
+      synchronize();
+
+    if (detail::probing)
+      stopProbes();
+
+    auto stoptime = Clock::now();
+    detail::record(id, detail::Transition::Pause, stoptime);
+    detail::leave(id);
+    state = State::PAUSED;
+    duration += Clock::duration(stoptime - starttime);
+  }
+}
+
+inline Event::Clock::duration Event::getDuration() const
+{
+  return duration;
+}
+
+inline int Event::getId() const
+{
+  return id;
+}
+
 
 /// Class that changes the prefix in its scope
 class ScopedEventPrefix
@@ -1,14 +1,33 @@
 #pragma once
 
+#include "EventTimings/Counter.hpp"
 #include "EventTimings/Event.hpp"
+#include "EventTimings/Probes.hpp"
+#include "EventTimings/Sinks.hpp"
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <set>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <mpi.h>
 
 namespace EventTimings {
 
+/// Point-to-point traffic sent to one peer rank
+struct Traffic
+{
+  long bytes = 0;
+  long messages = 0;
+};
+
 /// Class that aggregates durations for a specific event.
 class EventData
 {
@@ -21,6 +40,12 @@ public:
   /// Adds an Events data.
   void put(Event const & event);
 
+  /// Adds the duration of one event instance
+  void put(Event::Clock::duration duration);
+
+  /// Adds data of events
+  void addData(Event::Data const & data);
+
   std::string getName() const;
 
   /// Get the average duration of all events so far.
@@ -46,12 +71,114 @@ public:
 
   Event::StateChanges stateChanges;
 
+  /// Index of the thread within the rank of each state change, empty if not known, e.g., after collecting
+  std::vector<std::int32_t> stateChangeThreads;
+
+  /// Number of starts, pauses and stops, used to estimate the overhead of the instrumentation
+  long transitions = 0;
+
+  /// Additional metrics of all events, summed up, e.g. from probes. Map of name -> value
+  std::map<std::string, double> metrics;
+
+  /// Traffic sent by this rank, map of peer rank in the communicator of the EventRegistry -> traffic
+  std::map<int, Traffic> sent;
+
+  /// Number of times the event ran, that are counted, but not in stateChanges, see EventRegistry::stateChangeThreshold
+  long untraced = 0;
+
+  /// Whether the state changes stopped being recorded, see EventRegistry::throttleRate
+  bool throttled = false;
+
 private:
   std::string name;
   long count = 0;
   std::map<std::string, std::vector<int>> data;
 };
 
+/// Tree of call paths, i.e., of events nested into other events.
+/** A node accounts the time of an event, that was started while the event of its parent node was running.
+The inclusive time of a node contains the time of its children, the exclusive time does not.
+Node 0 is the root, it represents no event. */
+class CallTree
+{
+public:
+  struct Node
+  {
+    Node(std::string name, int parent);
+
+    std::string name;
+
+    /// Index of the parent node, -1 for the root
+    int parent;
+
+    /// Number of times the event was started at this node
+    long count = 0;
+
+    Event::Clock::duration inclusive = Event::Clock::duration::zero();
+
+    /// Number of starts, pauses and stops at this node
+    long transitions = 0;
+
+    /// Map of child name -> index of the child in CallTree::nodes
+    std::unordered_map<std::string, int> children;
+  };
+
+  CallTree();
+
+  /// Returns the index of the child of parent with the given name, creates the child if necessary.
+  int child(int parent, std::string const & name);
+
+  /// Get the inclusive time less the inclusive times of all children
+  Event::Clock::duration getExclusive(int node) const;
+
+  /// Returns the indices of the children of node, sorted by name
+  std::vector<int> getChildren(int node) const;
+
+  /// Visits all nodes below the root depth-first, siblings are visited sorted by name.
+  /** The root has depth 0, so the visited nodes start at depth 1. */
+  void traverse(std::function<void(int node, int depth)> const & visitor) const;
+
+  /// Adds the counts and times of other to this tree, merging nodes of equal call paths
+  void merge(CallTree const & other);
+
+  /// Writes the exclusive time of each call path as folded stack, i.e., one line "a;b;c <nanoseconds>"
+  /** Paths without exclusive time are omitted. prefix is prepended to each path. */
+  void writeFolded(std::ostream & out, std::string const & prefix = "") const;
+
+  /// Removes all nodes, except the root
+  void clear();
+
+  /// All nodes, a parent always has a lower index than its children
+  std::vector<Node> nodes;
+
+private:
+  void traverse(int node, int depth, std::function<void(int, int)> const & visitor) const;
+};
+
+/// A decision of the overhead budget controller, see EventRegistry::overheadBudget
+struct BudgetDecision
+{
+  /// Seconds after initialize
+  double time;
+
+  /// Estimated share of the runtime spent in the instrumentation, before the decision
+  double overhead;
+
+  /// "shed" or "restore" an event, "slower-sampling" or "faster-sampling"
+  std::string action;
+
+  /// Name of the event or sampling interval in microseconds
+  std::string subject;
+};
+
+/// A state change of an event in the timeline of a rank, see RankData::timeline
+struct TimelineEntry
+{
+  EventData const * event;
+  Event::State state;
+  Event::Clock::time_point time;
+};
+
 /// Holds all EventData of one particular rank
 class RankData
 {
@@ -63,6 +190,15 @@ public:
   /// Records the finalized timestamp
   void finalize();
 
+  /// Records given initialized timestamps, e.g., of a crash dump
+  void initialize(std::chrono::system_clock::time_point at, std::chrono::steady_clock::time_point ticks);
+
+  /// Records given finalized timestamps, e.g., of a crash dump
+  void finalize(std::chrono::system_clock::time_point at, std::chrono::steady_clock::time_point ticks);
+
+  /// Steady clock at initialize, the origin of the state changes before normalizeTo
+  std::chrono::steady_clock::time_point getInitializedAtTicks() const;
+
   /// Adds a new event
   void put(Event const & event);
 
@@ -72,16 +208,44 @@ public:
   /// Normalizes all Events to zero time of t0
   void normalizeTo(std::chrono::system_clock::time_point t0);
 
+  /// Subtracts the estimated overhead of the instrumentation from the total and inclusive times.
+  /** The overhead of an event contains the overhead of all events nested into it. The total of an event
+  is compensated at its outermost runs only, the overhead of recursive runs is already part of them. */
+  void compensateOverhead();
+
+  /// Estimated overhead of all transitions of this rank, in milliseconds
+  double getOverhead() const;
+
+  /// Returns the state changes of all events, sorted by time.
+  /** The state changes of an event are sorted, except where threads interleave, so its sorted runs are merged by a
+  k-way merge in O(n log k). Entries point into evData. */
+  std::vector<TimelineEntry> timeline() const;
+
   /// Clears all Event data
   void clear();
 
   /// Map of EventName -> EventData, should be private later
   std::map<std::string, EventData> evData;
 
+  /// Call paths of the events of this rank
+  CallTree callTree;
+
+  /// Map of counter name -> time series of this rank
+  std::map<std::string, CounterSeries> counters;
+
+  /// Decisions of the overhead budget controller on this rank
+  std::vector<BudgetDecision> decisions;
+
   std::chrono::system_clock::duration getDuration() const;
 
   std::chrono::system_clock::time_point initializedAt;
   std::chrono::system_clock::time_point finalizedAt;
+
+  /// Estimated cost of a single transition (start, pause, stop) of an event, in nanoseconds
+  double transitionCost = 0;
+
+  /// Whether the estimated overhead was subtracted from the times
+  bool compensated = false;
   
 private:
   std::chrono::steady_clock::time_point initializedAtTicks;
@@ -92,15 +256,45 @@ private:
 
 };
 
+/// Writes the data of a rank as a block of the binary event log, see BinaryLog.hpp
+void writeBinaryLog(std::ostream & out, RankData const & data, int rank);
+
+/// Reads all blocks of a binary event log and appends their ranks and data, returns false if it is invalid.
+/** The state changes are not normalized yet. */
+bool readBinaryLog(std::string const & file, std::vector<std::pair<int, RankData>> & ranks);
+
 /// Holds data aggregated from all MPI ranks for one event
 struct GlobalEventStats
 {
   int maxRank, minRank;
   Event::Clock::duration max   = Event::Clock::duration::min();
   Event::Clock::duration min   = Event::Clock::duration::max();
+
+  /// Total time, summed over all ranks
+  Event::Clock::duration total = Event::Clock::duration::zero();
+
+  /// Metrics, summed over all ranks
+  std::map<std::string, double> metrics;
 };
 
 
+namespace detail {
+
+/// Number of running MPI-IO calls of the thread, POSIX I/O within them is not counted separately
+extern thread_local int mpiIODepth;
+
+/// Passes the I/O hook to the EventTimingsIO library, if it is loaded, or removes it
+void setIOHooks(bool enabled);
+
+/// Releases the buffer of a thread, when the thread exits, see EventRegistry::releaseThread
+struct ThreadExit;
+
+}
+
+namespace telemetry {
+struct Segment;
+}
+
 /// High level object that stores data of all events.
 /** Call EventRegistry::intialize at the beginning of your application and
 EventRegistry::finalize at the end. Event timings will be usuable without calling this
@@ -117,7 +311,7 @@ public:
   /// Returns the only instance (singleton) of the EventRegistry class
   static EventRegistry & instance();
 
-  /// Sets the global start time
+  /// Sets the global start time and adds the sinks of the configured formats, see configure
   /**
    * @param[in] applicationName A name that is added to the logfile to distinguish different participants
    * @param[in] runName A name of the run, will be printed as a separate column with each Event.
@@ -131,23 +325,154 @@ public:
   /// Clears the registry. needed for tests
   void clear();
 
-  /// Finalizes the timings and calls print. Can be used as a crash handler to still get some timing results.
+  /// Writes the crash dump of this rank to appName-events.rank<N>.crash, using only async-signal-safe calls.
+  /** Can be called from a signal handler, see crashDump. The dump holds the timings, state changes and call tree
+  flushed so far and the raw records of all threads, but no data, metrics, messages and counters.
+  As the registry is not locked, it may be inconsistent, if a thread was replaying records. Merge dumps to the
+  usual outputs by readCrashDumps or the et-postmortem tool. */
   void signal_handler(int signal);
 
+  /// Replaces the data of all ranks by binary event logs, to be written by printAll afterwards.
+  /** The logs are read by the given number of threads, zero uses all cores, and normalized as by finalize.
+  Does not communicate. Returns false, if no rank was read. */
+  bool readBinaryLogs(std::vector<std::string> const & files, unsigned threads = 0);
+
+  /// Replaces the data of all ranks by the crash dumps of signal_handler, to be written by printAll afterwards.
+  /** Events running at the crash are stopped at the time of the crash. Does not communicate.
+  Returns false, if no rank was read. */
+  bool readCrashDumps(std::vector<std::string> const & files);
+
   /// Records the event.
   void put(Event const & event);
 
+  /// Adds data to the event of the given id
+  void putData(int id, Event::Data const & data);
+
+  /// Adds a probe, that is read on every start, pause and stop of every event.
+  /** Its values are reported as metrics of the events. Probes make starting and stopping events slower. */
+  void addProbe(std::unique_ptr<Probe> probe);
+
+  /// Reads the current values of all probes
+  void readProbes(std::vector<long long> & values);
+
+  /// Adds the accumulated values of all probes to the metrics of the event of the given id
+  void putProbeValues(int id, std::vector<long long> const & values);
+
+  /// Returns the slot of a call of a group, e.g. "mpi" and "Allreduce", to be passed to putCall.
+  /** Locks the registry, so call sites look the slot up once, e.g., in a function-local static. */
+  int getCallSlot(std::string const & group, std::string const & call);
+
+  /// Adds a call to the innermost running event of the calling thread, without locking.
+  /** The call is summed up in the buffer of the thread and added to the metrics "<group>.time", "<group>.calls",
+  "<group>.bytes" and "<group>.<call>.*" of the event, when the buffer is replayed. Calls outside of any event
+  and calls of the EventRegistry itself while finalizing are ignored. Used by the EventTimingsPMPI library for
+  MPI calls, group "mpi", and for MPI-IO and by the EventTimingsIO library for POSIX I/O, group "io". */
+  void putCall(int slot, long bytes, Event::Clock::duration duration);
+
+  /// Adds an MPI call, e.g. "Allreduce", like putCall, but looks its slot up on every call
+  void putMPICall(std::string const & call, long bytes, Event::Clock::duration duration);
+
+  /// Adds an I/O call, e.g. "write", like putCall, but looks its slot up on every call
+  void putIOCall(std::string const & call, long bytes, Event::Clock::duration duration);
+
+  /// Adds the time between entering and leaving a barrier of the event of the given id.
+  /** The barrier is left, when the last rank arrived, so the wait is the skew of the arrival of this rank. */
+  void putBarrierWait(int id, Event::Clock::duration wait);
+
+  /// Adds a message of bytes sent to peer to the innermost running event of the calling thread.
+  /** peer is the rank in the communicator of the EventRegistry. Messages are added by the EventTimingsPMPI
+  library, without it they can be added explicitly. Like putCall, the messages are summed up in the buffer of
+  the thread without locking and added when it is replayed. Messages while finalizing are ignored. */
+  void putMessage(int peer, long bytes);
+
+  /// Starts the sampling profiler, that samples the running events of the thread consuming CPU time.
+  /** Every interval of CPU time a SIGPROF signal records the running events and, if instructionPointers,
+  the instruction pointer. The samples are reported per event with their hotspot functions.
+  Sampling is stopped by stopSampling or finalize. */
+  void startSampling(std::chrono::microseconds interval = std::chrono::milliseconds(10),
+                     bool instructionPointers = true);
+
+  /// Stops the sampling profiler and restores the previous SIGPROF handler
+  void stopSampling();
+
+  /// Returns the counter of the given name, creates it if necessary.
+  /** The returned reference stays valid, the series of all counters are collected on finalize. */
+  Counter & counter(std::string const & name);
+
+  /// Returns the id of an event name, registers the name if necessary
+  int getId(std::string const & name);
+
+  /// Returns the id of an event name like getId and whether events of the name are recorded, see isRecorded.
+  /** The ids are cached per thread, the cache is invalidated by detail::passingVersion. */
+  int getId(std::string const & name, bool & recorded);
+
+  /// Reads the configuration from the file given by EVENTTIMINGS_CONFIG and from the EVENTTIMINGS_* variables.
+  /** Variables take precedence over the file. It is called once, when the registry is created, so filters apply
+  to events created before initialize and settings made in code afterwards override the configuration.
+  See docs/README.md for the variables. */
+  void configure();
+
+  /// Sets regular expressions (ECMAScript), an event is recorded if its name matches include and not exclude.
+  /** An empty include matches every name, an empty exclude none. The decision is cached per name and applies
+  from the next start of each event on. _GLOBAL is always recorded. Throws std::regex_error for invalid expressions. */
+  void setFilter(std::string const & include, std::string const & exclude);
+
+  /// Writes the timings and call tree, that this rank flushed so far, to appName-events.rank<N>.snapshot.json.
+  /** Only the buffer of the calling thread is flushed. The file is replaced atomically, so it can be watched
+  while the application runs. Written automatically every snapshotInterval, see flushInterval. */
+  void snapshot();
+
+  /// Replays and clears the records of all thread buffers.
+  /** Buffers of other threads must not be written while flushing. */
+  void flush();
+
   /// Returns or creates a stored event, i.e., an event with life beyond the current scope
   Event & getStoredEvent(std::string const & name);
 
-  /// Prints a pretty report to stdout and a JSON report to appName-events.json
+  /// Passes the data of all ranks to the sinks, only at rank 0.
+  /** By default, i.e., with all formats, it prints a pretty report to stdout, a JSON report to appName-events.json,
+  folded stacks to appName-events.folded (merged) and appName-events-ranks.folded
+  and, if any messages were recorded, the communication matrices to appName-events.comm
+  and, if any counters were recorded, their time series to appName-events.counters */
   void printAll();
 
+  /// Adds a sink, that receives the runs of events while running or the results on finalize and printAll.
+  /** Add streaming sinks before initialize, as only runs replayed after adding are passed. */
+  void addSink(std::unique_ptr<Sink> sink);
+
   /// Prints the result table to an arbitrary stream, only prints at rank 0.
   void writeSummary(std::ostream & out);
 
+  /// Prints the result table of the data of the given ranks, e.g., as passed to Sink::write, only at rank 0.
+  void writeSummary(std::ostream & out, std::vector<RankData> const & ranks);
+
   /// Writes the aggregated timings and state changes at JSON, only at rank 0.
   void writeJSON(std::ostream & out);
+
+  /// Writes the aggregated timings and state changes of the data of the given ranks as JSON.
+  void writeJSON(std::ostream & out, std::vector<RankData> const & ranks);
+
+  /// Writes the communication matrix of each event as sparse coordinate list, only at rank 0.
+  /** One line "<event>\t<source>\t<target>\t<bytes>\t<messages>" per pair of ranks, that communicated. */
+  void writeCommunication(std::ostream & out);
+
+  /// Writes the communication matrices of the data of the given ranks, only at rank 0.
+  void writeCommunication(std::ostream & out, std::vector<RankData> const & ranks);
+
+  /// Writes the time series of all counters of all ranks in a columnar binary format, only at rank 0.
+  /** See docs/LogFormat.md for the layout. */
+  void writeCounterSeries(std::ostream & out);
+
+  /// Writes the time series of the counters of the data of the given ranks, only at rank 0.
+  void writeCounterSeries(std::ostream & out, std::vector<RankData> const & ranks);
+
+  /// Writes the call trees as folded stacks for flame graphs, only at rank 0.
+  /** If merged, the times of equal call paths are summed up over all ranks,
+  otherwise every path starts with the rank, e.g. "rank 3;solve". */
+  void writeFolded(std::ostream & out, bool merged = true);
+
+  /// Writes the call trees of the data of the given ranks as folded stacks, only at rank 0.
+  void writeFolded(std::ostream & out, std::vector<RankData> const & ranks, bool merged = true);
   
   MPI_Comm const & getMPIComm() const;
 
@@ -157,11 +482,198 @@ public:
   /// A name that is added to the logfile to identify a run
   std::string runName;
 
+  /// Subtract the estimated overhead of the instrumentation from the times on finalize
+  bool compensateOverhead = false;
+
+  /// Whether events are recorded at all, set by EVENTTIMINGS_ENABLE.
+  /** If disabled, events are not recorded, do not synchronize and initialize, finalize and printAll do nothing. */
+  bool enabled = true;
+
+  /// Directory of the files written by printAll and snapshot, set by EVENTTIMINGS_OUTPUT_DIR, empty for the working directory
+  std::string outputDirectory;
+
+  /// Formats of the sinks added by initialize, set by EVENTTIMINGS_FORMAT, see makeSink.
+  /** "csv" and "trace" are available in addition to the default ones. */
+  std::set<std::string> formats = {"summary", "json", "folded", "comm", "counters"};
+
+  /// Whether the state changes of events are kept for the timeline, set by EVENTTIMINGS_RECORD ("all" or "aggregate")
+  bool recordStateChanges = true;
+
+  /// Interval of automatic snapshots, set by EVENTTIMINGS_SNAPSHOT_INTERVAL in seconds, zero disables them
+  std::chrono::duration<double> snapshotInterval{0};
+
+  /// Whether finalize collects the data of all ranks at rank 0, set by EVENTTIMINGS_COLLECT.
+  /** Otherwise finalize does not communicate at all, printAll does nothing and each rank writes its data to
+  appName-events.rank<N>.bin, as the format bin is implied. Merge the files by the et-merge tool. */
+  bool collectRanks = true;
+
+  /// Whether initialize installs signal_handler for SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT and SIGTERM.
+  /** Set by EVENTTIMINGS_CRASH_DUMP. The handler writes the dump, then restores the previous action of the signal and
+  passes the signal to it, i.e., handlers installed before initialize still run, otherwise the default action. */
+  bool crashDump = false;
+
+  /// Interval of publishing the statistics to shared memory, set by EVENTTIMINGS_TELEMETRY_INTERVAL in seconds.
+  /** Each rank publishes the statistics of its events to the segment /eventtimings.<pid>, when a buffer is flushed
+  and the interval has elapsed, see flushInterval. Read them by the et-top tool. Zero disables it. */
+  std::chrono::duration<double> telemetryInterval{0};
+
+  /// Runs of events shorter than this are counted, but have no state changes, set by EVENTTIMINGS_THRESHOLD in seconds
+  /** A run lasts from a start to the next pause or stop. */
+  std::chrono::duration<double> stateChangeThreshold{0};
+
+  /// State changes per second of runtime, above which an event is throttled, set by EVENTTIMINGS_THROTTLE_RATE.
+  /** A throttled event records no more state changes, but is still counted. Zero disables it. */
+  double throttleRate = 0;
+
+  /// Share of the runtime spent in starting and stopping an event, above which it is throttled,
+  /// set by EVENTTIMINGS_THROTTLE_OVERHEAD, e.g. 0.01. Zero disables it.
+  double throttleOverhead = 0;
+
+  /// Number of state changes of an event, before it may be throttled
+  static constexpr long throttleMinimum = 1000;
+
+  /// Maximum share of the runtime spent in the instrumentation, set by EVENTTIMINGS_BUDGET, e.g. 0.01. Zero disables it.
+  /** The controller estimates the overhead from the transitions, samples and the time spent replaying them
+  every budgetInterval, when a thread stops an event or its buffer is full. Above the budget, it slows down sampling or sheds the event
+  with the most transitions, i.e., events of its name are not recorded from their next start on.
+  Below half the budget, it restores shed events and speeds up sampling to the interval given to startSampling.
+  The decisions are part of the summary and the JSON file. */
+  double overheadBudget = 0;
+
+  /// Minimum interval between two decisions of the overhead budget controller
+  std::chrono::duration<double> budgetInterval{1};
+
 private:
+  friend class Event;
+  friend detail::Buffer * detail::overflow();
+  friend struct detail::ThreadExit;
+
   /// Private, empty constructor for singleton pattern
   EventRegistry()
     : globalEvent("_GLOBAL", true, false) // Unstarted, it's started in initialize
-  {}
+  {
+    globalEvent.id = getId(globalEvent.name);
+    configure();
+  }
+
+  /// An event that is running on a thread, while replaying the records of the thread
+  struct RunningEvent
+  {
+    int id;
+    int node;
+    Event::Clock::rep start;
+
+    /// Whether the state change of the start was recorded
+    bool traced;
+  };
+
+  /// Creates the buffer of a new thread or recycles the buffer of a thread, that exited
+  detail::Buffer * registerThread();
+
+  /// Flushes the buffer of an exiting thread and keeps it for the next thread, that registers.
+  /** Records of threads, that exit while the registry is not initialized, are discarded. */
+  void releaseThread(detail::Buffer & buffer);
+
+  /// Replays and clears the records of a thread buffer
+  void flush(detail::Buffer & buffer);
+
+  /// Returns whether events of the given id are recorded, i.e., recording is enabled and the name passes the filter
+  bool isRecorded(int id);
+
+  /// Records of a thread and the running events, as replayed so far
+  struct Thread
+  {
+    detail::Buffer buffer;
+    std::vector<RunningEvent> running;
+  };
+
+  /// Guards registering of names and threads and replaying
+  std::mutex mutex;
+
+  std::vector<std::unique_ptr<Thread>> threads;
+
+  /// Indices of threads, that exited, their buffers are recycled by registerThread
+  std::vector<int> freeThreads;
+
+  /// Registered event names, indexed by id
+  std::vector<std::string> names;
+
+  /// Map of event name -> id
+  std::unordered_map<std::string, int> ids;
+
+  /// Whether the name of an id passes the filter, indexed by id
+  std::vector<char> passing;
+
+  /// Filter of event names, see setFilter
+  std::regex include, exclude;
+  bool hasInclude = false, hasExclude = false;
+
+  /// Time of the last snapshot
+  Event::Clock::time_point lastSnapshot;
+
+  /// Interval, after which a thread flushes its buffer at the next stop of an event, even if it is not full.
+  /** The shortest interval of the periodic work, i.e., snapshots, telemetry and the budget controller, set by initialize. Flushing runs the
+  work, whose interval elapsed. Zero, if there is no periodic work. */
+  Event::Clock::duration flushInterval = Event::Clock::duration::zero();
+
+  /// Sets the deadline of a buffer to flushInterval after now, must be called with mutex locked
+  void scheduleFlush(detail::Buffer & buffer, Event::Clock::time_point now);
+
+  /// Shared-memory segment of the telemetry, nullptr if not published
+  telemetry::Segment * telemetry = nullptr;
+
+  /// Time the telemetry was last published
+  Event::Clock::time_point lastTelemetry;
+
+  /// File of signal_handler, set by initialize, so the handler does not allocate
+  std::string crashDumpFile;
+
+  /// EventData of localRankData, indexed by id, created when first used
+  std::vector<EventData *> eventData;
+
+  /// Map of (parent node, id) -> call tree node of localRankData
+  std::unordered_map<unsigned long long, int> childNodes;
+
+  std::vector<std::unique_ptr<Probe>> probes;
+
+  std::vector<std::unique_ptr<Sink>> sinks;
+
+  /// Whether any sink is streaming
+  bool streaming = false;
+
+  /// A run replayed for the streaming sinks, the name is copied, as names may grow while it is delivered
+  struct PendingRun
+  {
+    std::string name;
+    int thread;
+    Event::Clock::duration start, stop;
+    bool stopped;
+  };
+
+  /// Runs replayed, but not yet passed to the streaming sinks, guarded by mutex
+  std::vector<PendingRun> pendingRuns;
+
+  /// Serializes the delivery of runs to the streaming sinks, locked before mutex
+  std::mutex sinkMutex;
+
+  /// Passes the pending runs to the streaming sinks, must be called with mutex unlocked.
+  /** Replaying only collects the runs, so the sinks, which usually write files, do not block the registry. */
+  void deliverRuns();
+
+  /// Whether the sinks of the formats were added
+  bool formatSinks = false;
+
+  /// Rank in comm, set by initialize
+  int commRank = 0;
+
+  /// Number of values of each probe
+  std::vector<size_t> probeSizes;
+
+  /// Metric names of the values of all probes
+  std::vector<std::string> probeMetrics;
+
+  /// Map of instruction pointer -> function name, cache of getSymbol
+  std::unordered_map<long long, std::string> symbols;
 
   RankData localRankData;
 
@@ -171,30 +683,164 @@ private:
   /// Gather EventData from all ranks on rank 0.
   void collect();
 
-  /// Normalize times among all ranks
-  void normalize();
+  /// Returns the time, the first rank initialized, reduced among all ranks
+  std::chrono::system_clock::time_point findFirstInitialized();
 
   /// Collects first initialize and last finalize time at rank 0.
   std::pair<std::chrono::system_clock::time_point, std::chrono::system_clock::time_point> collectInitAndFinalize();
 
-  /// Returns length of longest name
-  size_t getMaxNameWidth();
+  /// Returns the length of the longest event name of all ranks
+  static size_t getMaxNameWidth(std::vector<RankData> const & ranks);
+
+  /// Returns the length of the longest event name of the statistics of all ranks
+  static size_t getMaxNameWidth(std::map<std::string, GlobalEventStats> const & stats);
+
+  /// Prints the table of performance counters
+  void writeCounters(std::ostream & out, std::map<std::string, GlobalEventStats> const & stats);
+
+  /// Prints the table of CPU times
+  void writeCPUTimes(std::ostream & out, std::vector<RankData> const & ranks,
+                     std::map<std::string, GlobalEventStats> const & stats);
+
+  /// Prints the tables of compute and MPI times and of the MPI calls
+  void writeMPI(std::ostream & out, std::vector<RankData> const & ranks,
+                std::map<std::string, GlobalEventStats> const & stats);
+
+  /// Prints the table of point-to-point traffic
+  void writeTraffic(std::ostream & out, std::vector<RankData> const & ranks);
+
+  /// Prints the table of the time spent waiting in barriers of events
+  void writeBarrierWaits(std::ostream & out, std::vector<RankData> const & ranks);
+
+  /// Prints the tables of the samples and hotspots of the sampling profiler
+  void writeSamples(std::ostream & out, std::map<std::string, GlobalEventStats> const & stats);
+
+  /// Prints the table of allocations and resident set size
+  void writeMemory(std::ostream & out, std::map<std::string, GlobalEventStats> const & stats);
+
+  /// Prints the table of I/O times and bandwidths
+  void writeIO(std::ostream & out, std::vector<RankData> const & ranks,
+               std::map<std::string, GlobalEventStats> const & stats);
+
+  /// Prints the table of the counters
+  void writeCounterSummary(std::ostream & out, std::vector<RankData> const & ranks);
+
+  /// Prints the table of the decisions of the overhead budget controller
+  void writeBudget(std::ostream & out, std::vector<RankData> const & ranks);
+
+  /// Metric names of a call slot, see getCallSlot
+  struct CallSlot
+  {
+    std::string groupTime, groupCalls, groupBytes, time, calls, bytes;
+  };
+
+  /// Call slots, indexed by slot
+  std::vector<CallSlot> callSlots;
+
+  /// Map of "<group>.<call>" -> slot
+  std::unordered_map<std::string, int> callSlotIds;
+
+  /// Adds the sums of the calls, messages and allocations of a thread to localRankData and clears them
+  void mergeCalls(Thread & thread);
 
   /// Finds the first initialized time and last finalized time in globalRankData
-  std::pair<std::chrono::system_clock::time_point, std::chrono::system_clock::time_point> findFirstAndLastTime();
+  std::pair<std::chrono::system_clock::time_point, std::chrono::system_clock::time_point> findFirstAndLastTime(std::vector<RankData> const & ranks);
 
   /// Event for measuring global time
   Event globalEvent;
 
   bool initialized = false;
 
+  /// Set while finalize normalizes and collects, so that its own MPI calls are not recorded
+  bool finalizing = false;
+
   std::map<std::string, Event> storedEvents;
 
+  /// Map of name -> counter, see counter
+  std::map<std::string, std::unique_ptr<Counter>> counters;
+
+  /// Aggregates the records of a thread into localRankData
+  void replay(Thread & thread);
+
+  /// Estimates the overhead since the last call and sheds or restores events and adjusts sampling to meet the budget.
+  /** Must be called with mutex locked. */
+  void controlOverhead();
+
+  /// Multiplies the sampling interval by factor, limited by the interval given to startSampling and one second.
+  /** Returns the new interval, zero if it is unchanged or not sampling. */
+  std::chrono::microseconds scaleSamplingInterval(double factor);
+
+  /// Estimated cost of a sample, in nanoseconds
+  double sampleCost = 0;
+
+  /// Work since the last decision of the overhead budget controller
+  long budgetRecords = 0, budgetSamples = 0;
+  Event::Clock::duration budgetFlushTime = Event::Clock::duration::zero();
+  Event::Clock::time_point lastBudgetDecision;
+
+  /// Records since the last decision, indexed by id
+  std::vector<long> budgetEventRecords;
+
+  /// Shed ids and their share of the runtime, when they were shed
+  std::vector<std::pair<int, double>> shed;
+
+  /// Returns whether a start of the event at timestamp is recorded as state change, throttles the event if necessary
+  bool isTraced(EventData & ed, Event::Clock::rep timestamp);
+
+  /// Returns whether a name passes the filter
+  bool passesFilter(std::string const & name) const;
+
+  /// Writes the snapshot, must be called with mutex locked
+  void writeSnapshot();
+
+  /// Normalizes the data of ranks read from files like finalize, by the given number of threads, and sets globalRankData.
+  /** Ranks not found get no events. Returns false, if there are no ranks. */
+  bool setGlobalRankData(std::vector<RankData> ranks, std::vector<bool> const & found, unsigned threads = 1);
+
+  /// Installs signal_handler for the fatal signals, keeping the previous actions to chain to
+  void installCrashHandler();
+
+  /// Creates and maps the shared-memory segment of the telemetry
+  void openTelemetry();
+
+  /// Writes the statistics of localRankData to the segment, must be called with mutex locked
+  void publishTelemetry();
+
+  /// Unmaps and removes the segment
+  void closeTelemetry();
+
+  /// Returns the output directory and base name of the files, e.g. "results/app-events"
+  std::string getOutputBase() const;
+
+  /// Creates the output directory and its parents, if necessary
+  void createOutputDirectory() const;
+
+  /// Adds the sinks of formats in front of the other sinks, unless they were added before
+  void addFormatSinks();
+
+  /// Allocates the sample ring of a buffer, if the sampler was started, must be called with mutex locked
+  void addSampleRing(detail::Buffer & buffer);
+
+  /// Aggregates and clears the samples of a thread into localRankData
+  void drainSamples(Thread & thread);
+
+  /// Returns the name of the function containing the instruction pointer
+  std::string const & getSymbol(long long ip);
+
+  /// Returns the EventData of localRankData for an id
+  EventData & getEventData(int id);
+
+  /// Returns the child node of parent for the event of the given id
+  int getChildNode(int parent, int id);
+
+  /// Measures the cost of a start/stop pair on this machine
+  void calibrate();
+
   /// A name that is added to the logfile to distinguish different participants
   std::string applicationName;
 
   /// MPI Communicator
-  MPI_Comm comm;
+  MPI_Comm comm = MPI_COMM_WORLD;
 };
 
 }
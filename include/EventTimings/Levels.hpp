@@ -0,0 +1,80 @@
+#pragma once
+
+#include "EventTimings/Event.hpp"
+
+/// Compile-time instrumentation level, events above this level are compiled to nothing.
+/** 0: Off, 1: Coarse, 2: Fine, 3: Detail. Define it before including this header or on the command line,
+e.g. -DEVENTTIMINGS_LEVEL=1 for production builds. Defaults to 3, i.e., all events are enabled. */
+#ifndef EVENTTIMINGS_LEVEL
+#define EVENTTIMINGS_LEVEL 3
+#endif
+
+namespace EventTimings {
+
+/// Granularity of instrumentation, from coarse phases to events in inner loops.
+enum class Level : int {
+  Off    = 0,
+  Coarse = 1,
+  Fine   = 2,
+  Detail = 3,
+};
+
+/// Returns whether events of the given level are compiled in
+constexpr bool isEnabled(Level level)
+{
+  return level != Level::Off and static_cast<int>(level) <= EVENTTIMINGS_LEVEL;
+}
+
+/// An Event of a given level, that is only compiled in if its level is enabled.
+/** Use like an Event: LeveledEvent<Level::Detail> e("solve/inner"); */
+template<Level L, bool Enabled = isEnabled(L)>
+class LeveledEvent : public Event
+{
+public:
+  using Event::Event;
+};
+
+/// A disabled event: all members are empty, so no string is built and no clock is read.
+template<Level L>
+class LeveledEvent<L, false>
+{
+public:
+  template<class... Args>
+  explicit LeveledEvent(Args &&...) {}
+
+  LeveledEvent(const LeveledEvent & other) = delete;
+
+  void start(bool = false) {}
+
+  void stop(bool = false) {}
+
+  void pause(bool = false) {}
+
+  Event::Clock::duration getDuration() const { return Event::Clock::duration::zero(); }
+
+  template<class Key>
+  void addData(Key &&, int) {}
+};
+
+}
+
+/// Macros that declare an event of the given level or, if the level is disabled, a LeveledEvent<Level::Off>.
+/** Unlike LeveledEvent, the arguments are not even evaluated when the level is disabled. The disabled event
+has the same members as an Event, which do nothing, so code using var still compiles. */
+#if EVENTTIMINGS_LEVEL >= 1
+#define EVENTTIMINGS_EVENT_COARSE(var, ...) ::EventTimings::Event var(__VA_ARGS__)
+#else
+#define EVENTTIMINGS_EVENT_COARSE(var, ...) ::EventTimings::LeveledEvent<::EventTimings::Level::Off> var
+#endif
+
+#if EVENTTIMINGS_LEVEL >= 2
+#define EVENTTIMINGS_EVENT_FINE(var, ...) ::EventTimings::Event var(__VA_ARGS__)
+#else
+#define EVENTTIMINGS_EVENT_FINE(var, ...) ::EventTimings::LeveledEvent<::EventTimings::Level::Off> var
+#endif
+
+#if EVENTTIMINGS_LEVEL >= 3
+#define EVENTTIMINGS_EVENT_DETAIL(var, ...) ::EventTimings::Event var(__VA_ARGS__)
+#else
+#define EVENTTIMINGS_EVENT_DETAIL(var, ...) ::EventTimings::LeveledEvent<::EventTimings::Level::Off> var
+#endif
@@ -0,0 +1,220 @@
+#pragma once
+
+#include "EventTimings/BinaryLog.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace EventTimings {
+namespace binary {
+
+/// Range of entries of a mapped log, that are read in place
+template<typename T>
+class View
+{
+public:
+  using const_iterator = T const *;
+
+  View() = default;
+
+  View(T const * first, std::size_t size) : first(first), count(size) {}
+
+  T const * begin() const { return first; }
+
+  T const * end() const { return first + count; }
+
+  std::size_t size() const { return count; }
+
+  bool empty() const { return count == 0; }
+
+  T const & operator[](std::size_t index) const { return first[index]; }
+
+private:
+  T const * first = nullptr;
+  std::size_t count = 0;
+};
+
+/// Characters of a string of a mapped log, not terminated
+class StringView
+{
+public:
+  StringView() = default;
+
+  StringView(char const * data, std::size_t size) : chars(data), length(size) {}
+
+  char const * data() const { return chars; }
+
+  std::size_t size() const { return length; }
+
+  std::string str() const { return std::string(chars, length); }
+
+  /// Compares like std::string::compare
+  int compare(char const * other, std::size_t otherLength) const
+  {
+    int const c = std::memcmp(chars, other, std::min(length, otherLength));
+    return c != 0 ? c : (length < otherLength ? -1 : length > otherLength);
+  }
+
+  bool operator==(std::string const & other) const { return compare(other.data(), other.size()) == 0; }
+
+  bool operator!=(std::string const & other) const { return not (*this == other); }
+
+private:
+  char const * chars = nullptr;
+  std::size_t length = 0;
+};
+
+inline std::ostream & operator<<(std::ostream & out, StringView s)
+{
+  return out.write(s.data(), s.size());
+}
+
+/// The data of a rank in a mapped log, see Log.
+/** Ranges of entries, that exceed their section, are clipped to it. Times are not normalized. */
+class Block
+{
+public:
+  /// Indexes a block, that was validated by Log
+  explicit Block(char const * data);
+
+  Header const & header() const { return *reinterpret_cast<Header const *>(data); }
+
+  int rank() const { return header().rank; }
+
+  StringView string(String s) const;
+
+  /// Events of the block, EventTimings writes them sorted by name
+  View<Event> events() const { return section<Event>(header().events); }
+
+  /// Returns the event of the given name in O(log n), nullptr if there is none
+  Event const * event(std::string const & name) const;
+
+  View<StateChange> stateChanges(Event const & event) const { return range<StateChange>(header().stateChanges, event.stateChanges); }
+
+  View<DataKey> dataKeys(Event const & event) const { return range<DataKey>(header().dataKeys, event.dataKeys); }
+
+  View<std::int32_t> values(DataKey const & key) const { return range<std::int32_t>(header().dataValues, key.values); }
+
+  View<Metric> metrics(Event const & event) const { return range<Metric>(header().metrics, event.metrics); }
+
+  View<Sent> sent(Event const & event) const { return range<Sent>(header().sent, event.sent); }
+
+  /// Nodes of the call tree, the root first and parents before their children
+  View<Node> nodes() const { return section<Node>(header().nodes); }
+
+  View<Counter> counters() const { return section<Counter>(header().counters); }
+
+  View<Sample> samples(Counter const & counter) const { return range<Sample>(header().samples, counter.samples); }
+
+  View<Decision> decisions() const { return section<Decision>(header().decisions); }
+
+  /// Intervals of an event, sorted by start
+  View<Interval> intervals(Event const & event) const { return range<Interval>(header().intervals, event.intervals); }
+
+  /// Indices of all intervals of the block, sorted by start
+  View<std::uint64_t> timeline() const { return section<std::uint64_t>(header().timeline); }
+
+  /// Returns the intervals, that overlap [from, to], sorted by start, in O(log n + k) by the checkpoints of the timeline
+  std::vector<Interval const *> intervals(std::int64_t from, std::int64_t to) const;
+
+  /// Returns the intervals of an event, that overlap [from, to], sorted by start
+  std::vector<Interval const *> intervals(Event const & event, std::int64_t from, std::int64_t to) const;
+
+  /// Returns the event of an interval, nullptr if its index is invalid
+  Event const * event(Interval const & interval) const
+  {
+    return interval.event < events().size() ? &events()[interval.event] : nullptr;
+  }
+
+private:
+  template<typename T>
+  View<T> section(Section const & s) const
+  {
+    return View<T>(reinterpret_cast<T const *>(data + s.offset), s.size);
+  }
+
+  template<typename T>
+  View<T> range(Section const & s, Range r) const
+  {
+    auto const first = std::min(r.first, s.size);
+    return View<T>(reinterpret_cast<T const *>(data + s.offset) + first, std::min(r.size, s.size - first));
+  }
+
+  /// Searches an index of intervals, given by the indices at positions or, if it is nullptr, the range positions
+  std::vector<Interval const *> overlapping(View<std::uint64_t> const * index, Range positions, Range checkpoints,
+                                            std::int64_t from, std::int64_t to) const;
+
+  char const * data;
+
+  /// Indices of the events, sorted by name
+  std::vector<std::uint32_t> byName;
+};
+
+/// A binary event log, mapped to memory and read in place.
+/** Opening a log reads only the headers of its blocks and the names of the events, so it takes the same time for any
+number of state changes. Views into a log are valid until it is closed.
+
+    binary::Log log("app-events.bin");
+    for (auto const & block : log)
+      if (auto event = block.event("solve"))
+        for (auto const & sc : block.stateChanges(*event))
+          ...
+
+Times are ticks of the steady clock of the rank, see Header::initializedAtTicks.
+*/
+class Log
+{
+public:
+  Log() = default;
+
+  /// Opens a log, check isOpen
+  explicit Log(std::string const & file);
+
+  Log(Log const &) = delete;
+  Log & operator=(Log const &) = delete;
+
+  Log(Log && other);
+  Log & operator=(Log && other);
+
+  ~Log();
+
+  /// Maps a log and validates its blocks, returns false and sets getError if it is invalid
+  bool open(std::string const & file);
+
+  void close();
+
+  bool isOpen() const { return mapped != nullptr; }
+
+  /// Reason, why the last open failed
+  std::string const & getError() const { return error; }
+
+  /// Blocks in the order of the log
+  std::vector<Block>::const_iterator begin() const { return blocks.begin(); }
+
+  std::vector<Block>::const_iterator end() const { return blocks.end(); }
+
+  std::size_t size() const { return blocks.size(); }
+
+  Block const & operator[](std::size_t index) const { return blocks[index]; }
+
+  /// Returns the last block of the given rank in O(log n), nullptr if there is none
+  Block const * rank(int rank) const;
+
+private:
+  void * mapped = nullptr;
+  std::size_t length = 0;
+
+  std::vector<Block> blocks;
+
+  /// Map of rank -> index of its last block
+  std::map<int, std::size_t> ranks;
+
+  std::string error;
+};
+
+}
+}
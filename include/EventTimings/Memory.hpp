@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+namespace EventTimings {
+
+/// Counts an allocation of bytes for the innermost running event of the calling thread.
+/** Called by the EventTimingsMalloc library for every allocation. Custom allocators, e.g., memory pools,
+can call it directly. The counts are summed up in the buffer of the thread and reported as metrics
+"memory.allocations" and "memory.allocated". Its own allocations are not counted. */
+void countAllocation(std::size_t bytes);
+
+/// Counts freeing bytes for the innermost running event of the calling thread, see countAllocation
+void countFree(std::size_t bytes);
+
+namespace detail {
+
+/// Passes countAllocation and countFree to the EventTimingsMalloc library, if it is loaded, or removes them
+void setAllocationHooks(bool enabled);
+
+}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace EventTimings {
+
+/// Source of additional per-event metrics, that is read whenever an event starts, pauses or stops.
+/** The differences of the values between start and pause or stop are summed up per event and
+reported as metrics named "<group>.<name>". Add probes by EventRegistry::addProbe. */
+class Probe
+{
+public:
+  virtual ~Probe() = default;
+
+  /// Group of the metrics, prepended to their names
+  virtual std::string getGroup() const = 0;
+
+  /// Names of the values, read returns one value per name
+  virtual std::vector<std::string> getNames() const = 0;
+
+  /// Reads the current values
+  virtual void read(long long * values) = 0;
+};
+
+/// Creates a probe for the hardware counters cycles, instructions, LLC-misses and branch-misses.
+/** The counters are read by perf_event_open, using rdpmc in user space where supported.
+If hardware counters are not available, e.g., in containers or virtual machines, it falls back to the
+software counters task-clock (nanoseconds), page-faults and context-switches.
+The group of the metrics is "perf". Each thread opens its own counters on its first read,
+so the counters of an event count the thread, that runs it. If the kernel multiplexes the counters,
+their values are scaled by the time enabled over the time running. */
+std::unique_ptr<Probe> makePerfCounterProbe();
+
+/// Creates a probe for the CPU time (nanoseconds) and the voluntary and involuntary context switches of a thread.
+/** The group of the metrics is "cpu". Comparing CPU time to wall time shows events, in which a rank waits,
+e.g. in MPI, or is descheduled on oversubscribed nodes. */
+std::unique_ptr<Probe> makeCPUTimeProbe();
+
+/// Creates a probe for the resident set size of the process and its peak, in bytes.
+/** The group of the metrics is "memory". The resident set size is read from /proc/self/statm,
+so the metric "memory.rss" of an event is the growth of the resident set size while it was running,
+"memory.peak-rss" the growth of the peak. */
+std::unique_ptr<Probe> makeMemoryProbe();
+
+}
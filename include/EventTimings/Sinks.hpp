@@ -0,0 +1,92 @@
+#pragma once
+
+#include "EventTimings/Event.hpp"
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace EventTimings {
+
+class RankData;
+
+/// A run of an event, i.e., from a start or resume to the next pause or stop
+struct Run
+{
+  std::string const & name;
+
+  /// Rank in the communicator of the EventRegistry
+  int rank;
+
+  /// Index of the thread within the rank
+  int thread;
+
+  /// Time since the rank initialized
+  Event::Clock::duration start, stop;
+
+  /// Whether the run ended by a stop, otherwise by a pause
+  bool stopped;
+};
+
+/// Receives the results of the EventRegistry, e.g., to write them in a format.
+/** Sinks are added by EventRegistry::addSink. A sink may stream, i.e., receive every run of every event on
+every rank after the records are replayed, and may receive the aggregated data of its rank on finalize
+or of all ranks at rank 0 on printAll. Streaming sinks are called one at a time, but not with the registry locked,
+so writing files does not block other threads. They must not create events or call the registry. */
+class Sink
+{
+public:
+  virtual ~Sink() = default;
+
+  /// Whether record is called
+  virtual bool isStreaming() const { return false; }
+
+  /// Called on every rank for each completed run of an event
+  virtual void record(Run const & /*run*/) {}
+
+  /// Called on every rank by finalize before finalizeRank with the time, this rank initialized after the first rank.
+  /** Adding it to the times of the runs aligns them among the ranks. Zero, if the ranks are not collected. */
+  virtual void alignRank(int /*rank*/, Event::Clock::duration /*delay*/) {}
+
+  /// Called on every rank by finalize with the data of this rank, before it is normalized and collected
+  virtual void finalizeRank(int /*rank*/, RankData const & /*data*/) {}
+
+  /// Called by printAll at rank 0 with the data of all ranks
+  virtual void write(std::vector<RankData> const & /*ranks*/) {}
+};
+
+/// Creates the sink of a format by name, base is the path of the files without extension, e.g. "out/app-events".
+/** Formats are "summary" (tables to stdout), "json", "folded", "comm", "counters", "csv", "trace" and "bin".
+Returns nullptr for unknown formats. */
+std::unique_ptr<Sink> makeSink(std::string const & format, std::string const & base);
+
+/// Creates a sink, that prints the summary tables to out
+std::unique_ptr<Sink> makeSummarySink(std::ostream & out);
+
+/// Creates a sink, that writes the JSON file, see docs/Events.schema.json
+std::unique_ptr<Sink> makeJSONSink(std::string const & file);
+
+/// Creates a sink, that writes the merged and the per-rank folded stacks to base.folded and base-ranks.folded
+std::unique_ptr<Sink> makeFoldedSink(std::string const & base);
+
+/// Creates a sink, that writes the communication matrices, if any messages were recorded
+std::unique_ptr<Sink> makeCommunicationSink(std::string const & file);
+
+/// Creates a sink, that writes the time series of the counters in the columnar binary format, if any were recorded
+std::unique_ptr<Sink> makeCounterSeriesSink(std::string const & file);
+
+/// Creates a sink, that writes the aggregated timings of each event and rank as comma-separated values.
+/** One line "rank,event,count,total,max,min,transitions" per event and rank, times in milliseconds. */
+std::unique_ptr<Sink> makeCSVSink(std::string const & file);
+
+/// Creates a sink, that writes the data of each rank by finalize to base.rank<N>.bin in the binary event log format.
+/** See BinaryLog.hpp, the files are merged by readBinaryLogs or the et-merge tool. */
+std::unique_ptr<Sink> makeBinarySink(std::string const & base);
+
+/// Creates a streaming sink, that writes every run to base.rank<N>.trace.json in the Chrome trace format.
+/** Each rank spills its runs to base.rank<N>.trace.part while running, so state changes need not be kept nor
+collected, and writes the file by finalize with the times since the first rank initialized.
+Combine it with EVENTTIMINGS_RECORD=aggregate for long runs. */
+std::unique_ptr<Sink> makeTraceSink(std::string const & base);
+
+}
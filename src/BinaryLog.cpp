@@ -0,0 +1,397 @@
+#include "EventTimings/EventUtils.hpp"
+#include "EventTimings/LogReader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <thread>
+
+namespace EventTimings {
+
+namespace {
+
+using sys_clk  = std::chrono::system_clock;
+using stdy_clk = std::chrono::steady_clock;
+using std::chrono::nanoseconds;
+
+constexpr std::uint64_t align(std::uint64_t bytes)
+{
+  return (bytes + 7) / 8 * 8;
+}
+
+/// Sections of a block, collected before they are written
+struct BlockWriter
+{
+  std::string strings;
+  std::vector<binary::Event> events;
+  std::vector<binary::StateChange> stateChanges;
+  std::vector<binary::DataKey> dataKeys;
+  std::vector<std::int32_t> dataValues;
+  std::vector<binary::Metric> metrics;
+  std::vector<binary::Sent> sent;
+  std::vector<binary::Node> nodes;
+  std::vector<binary::Counter> counters;
+  std::vector<binary::Sample> samples;
+  std::vector<binary::Decision> decisions;
+  std::vector<binary::Interval> intervals;
+  std::vector<std::uint64_t> timeline;
+  std::vector<binary::Checkpoint> checkpoints;
+  std::vector<std::uint64_t> open;
+
+  binary::String string(std::string const & s)
+  {
+    binary::String const result{strings.size(), s.size()};
+    strings += s;
+    return result;
+  }
+
+  template<typename T>
+  binary::Range range(std::vector<T> const & section, std::uint64_t first) const
+  {
+    return {first, section.size() - first};
+  }
+};
+
+/// Orders intervals by start, longer ones first
+bool earlier(binary::Interval const & a, binary::Interval const & b)
+{
+  return a.start < b.start or (a.start == b.start and a.stop > b.stop);
+}
+
+/// Starts of the runs of an event on a thread, that are not closed yet, and the last state of the thread
+struct ThreadRuns
+{
+  std::vector<std::int64_t> started;
+  Event::State previous = Event::State::STOPPED;
+};
+
+/// Appends the intervals of an event, a start or resume is closed by the next pause or stop of the same thread,
+/// unfinished ones by stop
+binary::Range addIntervals(BlockWriter & w, EventData const & e, std::int64_t stop)
+{
+  auto const firstInterval = w.intervals.size();
+  std::uint64_t const event = w.events.size();
+  // Runs of threads are interleaved, so they are paired per thread, state changes without threads as one thread
+  std::map<std::int32_t, ThreadRuns> threads;
+  for (size_t i = 0; i < e.stateChanges.size(); ++i) {
+    auto const & sc = e.stateChanges[i];
+    auto & thread = threads[i < e.stateChangeThreads.size() ? e.stateChangeThreads[i] : 0];
+    auto const time = sc.second.time_since_epoch().count();
+    if (sc.first == Event::State::STARTED)
+      thread.started.push_back(time);
+    // A stop after a pause ends no run, see Transition::StopPaused
+    else if (not thread.started.empty()
+             and not (sc.first == Event::State::STOPPED and thread.previous == Event::State::PAUSED)) {
+      w.intervals.push_back({thread.started.back(), time, event});
+      thread.started.pop_back();
+    }
+    thread.previous = sc.first;
+  }
+  for (auto const & thread : threads)
+    for (auto start : thread.second.started)
+      w.intervals.push_back({start, std::max(start, stop), event});
+  std::sort(w.intervals.begin() + firstInterval, w.intervals.end(), earlier);
+  return w.range(w.intervals, firstInterval);
+}
+
+/// Appends the checkpoints of an index, i.e., the indices of intervals sorted by start, see binary::Checkpoint
+binary::Range addCheckpoints(BlockWriter & w, std::vector<std::uint64_t> const & index)
+{
+  auto const firstCheckpoint = w.checkpoints.size();
+  // Heap of the stops and positions of the intervals, that may still be open, the earliest stop on top
+  using Open = std::pair<std::int64_t, std::uint64_t>;
+  std::vector<Open> open;
+  std::vector<std::uint64_t> positions;
+  for (std::uint64_t position = 0; position < index.size(); ++position) {
+    auto const & interval = w.intervals[index[position]];
+    // Starts do not decrease, so an interval, that stopped before this one, is closed at all later checkpoints
+    while (not open.empty() and open.front().first < interval.start) {
+      std::pop_heap(open.begin(), open.end(), std::greater<Open>());
+      open.pop_back();
+    }
+    if (position % binary::checkpointInterval == 0) {
+      positions.clear();
+      for (auto const & o : open)
+        positions.push_back(o.second);
+      std::sort(positions.begin(), positions.end());
+      auto const firstOpen = w.open.size();
+      for (auto p : positions)
+        w.open.push_back(index[p]);
+      w.checkpoints.push_back({w.range(w.open, firstOpen)});
+    }
+    open.emplace_back(interval.stop, position);
+    std::push_heap(open.begin(), open.end(), std::greater<Open>());
+  }
+  return w.range(w.checkpoints, firstCheckpoint);
+}
+
+/// Sets the offset and size of a section and advances offset past it
+void place(binary::Section & section, std::uint64_t & offset, std::uint64_t size, std::uint64_t entrySize)
+{
+  section = {offset, size};
+  offset += align(size * entrySize);
+}
+
+/// Writes the entries of a section, padded to 8 bytes
+void writeSection(std::ostream & out, void const * data, std::uint64_t bytes)
+{
+  static char const padding[8] = {};
+  out.write(static_cast<char const *>(data), bytes);
+  out.write(padding, align(bytes) - bytes);
+}
+
+template<typename T>
+void writeSection(std::ostream & out, std::vector<T> const & entries)
+{
+  writeSection(out, entries.data(), entries.size() * sizeof(T));
+}
+
+/// Converts a block to the data of its rank
+RankData readBlock(binary::Block const & block)
+{
+  auto const & h = block.header();
+  RankData data;
+  data.initialize(sys_clk::time_point(std::chrono::duration_cast<sys_clk::duration>(nanoseconds(h.initializedAt))),
+                  stdy_clk::time_point(nanoseconds(h.initializedAtTicks)));
+  data.finalize(sys_clk::time_point(std::chrono::duration_cast<sys_clk::duration>(nanoseconds(h.finalizedAt))),
+                stdy_clk::time_point(nanoseconds(h.initializedAtTicks + h.finalizedAt - h.initializedAt)));
+  data.transitionCost = h.transitionCost;
+  data.compensated = h.compensated;
+
+  for (auto const & e : block.events()) {
+    Event::StateChanges stateChanges;
+    auto const changes = block.stateChanges(e);
+    stateChanges.reserve(changes.size());
+    std::vector<std::int32_t> threads;
+    threads.reserve(changes.size());
+    for (auto const & change : changes) {
+      stateChanges.emplace_back(static_cast<Event::State>(change.state),
+                                Event::Clock::time_point(nanoseconds(change.timestamp)));
+      threads.push_back(change.thread);
+    }
+
+    Event::Data eventData;
+    for (auto const & key : block.dataKeys(e)) {
+      auto const values = block.values(key);
+      eventData[block.string(key.key).str()].assign(values.begin(), values.end());
+    }
+
+    EventData ed(block.string(e.name).str(), e.count, 0, 0, 0, std::move(eventData), std::move(stateChanges));
+    ed.total = nanoseconds(e.total);
+    ed.max = nanoseconds(e.max);
+    ed.min = nanoseconds(e.min);
+    ed.transitions = e.transitions;
+    ed.untraced = e.untraced;
+    ed.throttled = e.throttled;
+    ed.stateChangeThreads = std::move(threads);
+    for (auto const & m : block.metrics(e))
+      ed.metrics[block.string(m.name).str()] = m.value;
+    for (auto const & s : block.sent(e)) {
+      ed.sent[s.peer].bytes = s.bytes;
+      ed.sent[s.peer].messages = s.messages;
+    }
+    data.addEventData(std::move(ed));
+  }
+
+  // Nodes are restored in order, so their indices are the same
+  auto & tree = data.callTree;
+  auto const nodes = block.nodes();
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    auto const & n = nodes[i];
+    auto const parent = std::min<std::int64_t>(std::max<std::int64_t>(n.parent, 0), tree.nodes.size() - 1);
+    int const node = i == 0 ? 0 : tree.child(parent, block.string(n.name).str());
+    tree.nodes[node].count = n.count;
+    tree.nodes[node].inclusive = nanoseconds(n.inclusive);
+    tree.nodes[node].transitions = n.transitions;
+  }
+
+  for (auto const & c : block.counters()) {
+    auto & series = data.counters[block.string(c.name).str()];
+    for (auto const & sample : block.samples(c)) {
+      series.timestamps.push_back(sample.timestamp);
+      series.values.push_back(sample.value);
+    }
+  }
+
+  for (auto const & d : block.decisions())
+    data.decisions.push_back({d.time, d.overhead, block.string(d.action).str(), block.string(d.subject).str()});
+  return data;
+}
+
+}
+
+void writeBinaryLog(std::ostream & out, RankData const & data, int rank)
+{
+  static_assert(std::is_same<Event::Clock::period, std::nano>::value, "Ticks of the steady clock must be nanoseconds");
+
+  auto const finalizedAtTicks = data.getInitializedAtTicks() + (data.finalizedAt - data.initializedAt);
+
+  BlockWriter w;
+  std::vector<std::uint64_t> index;
+  for (auto const & ev : data.evData) {
+    auto const & e = ev.second;
+    binary::Event entry{};
+    entry.name = w.string(ev.first);
+    entry.count = e.getCount();
+    entry.total = e.total.count();
+    entry.max = e.max.count();
+    entry.min = e.min.count();
+    entry.transitions = e.transitions;
+    entry.untraced = e.untraced;
+    entry.throttled = e.throttled;
+
+    auto const firstStateChange = w.stateChanges.size();
+    for (size_t i = 0; i < e.stateChanges.size(); ++i) {
+      auto const & sc = e.stateChanges[i];
+      std::int32_t const thread = i < e.stateChangeThreads.size() ? e.stateChangeThreads[i] : 0;
+      w.stateChanges.push_back({sc.second.time_since_epoch().count(), static_cast<std::int32_t>(sc.first), thread});
+    }
+    entry.stateChanges = w.range(w.stateChanges, firstStateChange);
+
+    auto const firstKey = w.dataKeys.size();
+    for (auto const & d : e.getData()) {
+      auto const firstValue = w.dataValues.size();
+      w.dataValues.insert(w.dataValues.end(), d.second.begin(), d.second.end());
+      w.dataKeys.push_back({w.string(d.first), w.range(w.dataValues, firstValue)});
+    }
+    entry.dataKeys = w.range(w.dataKeys, firstKey);
+
+    auto const firstMetric = w.metrics.size();
+    for (auto const & m : e.metrics)
+      w.metrics.push_back({w.string(m.first), m.second});
+    entry.metrics = w.range(w.metrics, firstMetric);
+
+    auto const firstSent = w.sent.size();
+    for (auto const & s : e.sent)
+      w.sent.push_back({s.first, s.second.bytes, s.second.messages});
+    entry.sent = w.range(w.sent, firstSent);
+
+    entry.intervals = addIntervals(w, e, finalizedAtTicks.time_since_epoch().count());
+    index.resize(entry.intervals.size);
+    std::iota(index.begin(), index.end(), entry.intervals.first);
+    entry.checkpoints = addCheckpoints(w, index);
+
+    w.events.push_back(entry);
+  }
+
+  for (auto const & node : data.callTree.nodes)
+    w.nodes.push_back({w.string(node.name), node.parent, node.count, node.inclusive.count(), node.transitions});
+
+  for (auto const & counter : data.counters) {
+    auto const firstSample = w.samples.size();
+    auto const & series = counter.second;
+    for (size_t i = 0; i < series.timestamps.size(); ++i)
+      w.samples.push_back({series.timestamps[i], series.values[i]});
+    w.counters.push_back({w.string(counter.first), w.range(w.samples, firstSample)});
+  }
+
+  for (auto const & d : data.decisions)
+    w.decisions.push_back({d.time, d.overhead, w.string(d.action), w.string(d.subject)});
+
+  w.timeline.resize(w.intervals.size());
+  std::iota(w.timeline.begin(), w.timeline.end(), 0);
+  std::stable_sort(w.timeline.begin(), w.timeline.end(), [&](std::uint64_t a, std::uint64_t b) {
+    return earlier(w.intervals[a], w.intervals[b]);
+  });
+
+  binary::Header h{};
+  std::copy(std::begin(binary::magic), std::end(binary::magic), h.magic);
+  h.version = binary::version;
+  h.rank = rank;
+  h.initializedAt = std::chrono::duration_cast<nanoseconds>(data.initializedAt.time_since_epoch()).count();
+  h.finalizedAt = std::chrono::duration_cast<nanoseconds>(data.finalizedAt.time_since_epoch()).count();
+  h.initializedAtTicks = data.getInitializedAtTicks().time_since_epoch().count();
+  h.transitionCost = data.transitionCost;
+  h.compensated = data.compensated;
+  h.checkpointInterval = binary::checkpointInterval;
+  h.timelineCheckpoints = addCheckpoints(w, w.timeline);
+
+  std::uint64_t offset = align(sizeof(h));
+  place(h.strings, offset, w.strings.size(), 1);
+  place(h.events, offset, w.events.size(), sizeof(binary::Event));
+  place(h.stateChanges, offset, w.stateChanges.size(), sizeof(binary::StateChange));
+  place(h.dataKeys, offset, w.dataKeys.size(), sizeof(binary::DataKey));
+  place(h.dataValues, offset, w.dataValues.size(), sizeof(std::int32_t));
+  place(h.metrics, offset, w.metrics.size(), sizeof(binary::Metric));
+  place(h.sent, offset, w.sent.size(), sizeof(binary::Sent));
+  place(h.nodes, offset, w.nodes.size(), sizeof(binary::Node));
+  place(h.counters, offset, w.counters.size(), sizeof(binary::Counter));
+  place(h.samples, offset, w.samples.size(), sizeof(binary::Sample));
+  place(h.decisions, offset, w.decisions.size(), sizeof(binary::Decision));
+  place(h.intervals, offset, w.intervals.size(), sizeof(binary::Interval));
+  place(h.timeline, offset, w.timeline.size(), sizeof(std::uint64_t));
+  place(h.checkpoints, offset, w.checkpoints.size(), sizeof(binary::Checkpoint));
+  place(h.open, offset, w.open.size(), sizeof(std::uint64_t));
+  h.blockSize = offset;
+
+  writeSection(out, &h, sizeof(h));
+  writeSection(out, w.strings.data(), w.strings.size());
+  writeSection(out, w.events);
+  writeSection(out, w.stateChanges);
+  writeSection(out, w.dataKeys);
+  writeSection(out, w.dataValues);
+  writeSection(out, w.metrics);
+  writeSection(out, w.sent);
+  writeSection(out, w.nodes);
+  writeSection(out, w.counters);
+  writeSection(out, w.samples);
+  writeSection(out, w.decisions);
+  writeSection(out, w.intervals);
+  writeSection(out, w.timeline);
+  writeSection(out, w.checkpoints);
+  writeSection(out, w.open);
+}
+
+bool readBinaryLog(std::string const & file, std::vector<std::pair<int, RankData>> & ranks)
+{
+  binary::Log log;
+  if (not log.open(file)) {
+    std::cerr << "EventTimings: " << log.getError() << std::endl;
+    return false;
+  }
+  for (auto const & block : log)
+    ranks.emplace_back(block.rank(), readBlock(block));
+  return true;
+}
+
+bool EventRegistry::readBinaryLogs(std::vector<std::string> const & files, unsigned threads)
+{
+  clear();
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min<size_t>(threads, std::max<size_t>(files.size(), 1));
+
+  // Each thread reads every threads-th file
+  std::vector<std::vector<std::pair<int, RankData>>> read(files.size());
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; ++t)
+    workers.emplace_back([&, t]() {
+      for (size_t i = t; i < files.size(); i += threads)
+        readBinaryLog(files[i], read[i]);
+    });
+  for (auto & worker : workers)
+    worker.join();
+
+  std::vector<RankData> ranks;
+  std::vector<bool> found;
+  for (auto & fileRanks : read) {
+    for (auto & rank : fileRanks) {
+      if (rank.first < 0)
+        continue;
+      if (static_cast<size_t>(rank.first) >= ranks.size()) {
+        ranks.resize(rank.first + 1);
+        found.resize(rank.first + 1, false);
+      }
+      if (found[rank.first])
+        std::cerr << "EventTimings: Rank " << rank.first << " is given twice, using the last one" << std::endl;
+      ranks[rank.first] = std::move(rank.second);
+      found[rank.first] = true;
+    }
+  }
+  return setGlobalRankData(std::move(ranks), found, threads);
+}
+
+}
@@ -0,0 +1,62 @@
+#include "EventTimings/EventUtils.hpp"
+
+#include <algorithm>
+
+namespace EventTimings {
+
+void EventRegistry::controlOverhead()
+{
+  auto const now = Event::Clock::now();
+  double const window = std::chrono::duration<double, std::nano>(now - lastBudgetDecision).count();
+  double const recordsCost = budgetRecords * localRankData.transitionCost;
+  double const samplesCost = budgetSamples * sampleCost;
+  double const overhead = (recordsCost + samplesCost +
+                           std::chrono::duration<double, std::nano>(budgetFlushTime).count()) / window;
+  double const time = std::chrono::duration<double>(now - globalEvent.starttime).count();
+  auto decide = [&](std::string action, std::string subject) {
+    localRankData.decisions.push_back({time, overhead, std::move(action), std::move(subject)});
+  };
+
+  if (overhead > overheadBudget) {
+    // Reduce the larger of the two sources of overhead
+    std::chrono::microseconds interval{0};
+    if (samplesCost > recordsCost)
+      interval = scaleSamplingInterval(2);
+    if (interval.count() > 0)
+      decide("slower-sampling", std::to_string(interval.count()));
+    else {
+      int busiest = -1;
+      for (size_t id = 0; id < budgetEventRecords.size(); ++id)
+        if (static_cast<int>(id) != globalEvent.id and passing[id] and budgetEventRecords[id] > 0
+            and (busiest < 0 or budgetEventRecords[id] > budgetEventRecords[busiest]))
+          busiest = id;
+      if (busiest >= 0) {
+        passing[busiest] = false;
+        detail::passingVersion++;
+        shed.emplace_back(busiest, budgetEventRecords[busiest] * localRankData.transitionCost / window);
+        decide("shed", names[busiest]);
+      }
+    }
+  }
+  else if (overhead < overheadBudget / 2) {
+    // Restore the event shed last, if its overhead fits, otherwise sample faster
+    if (not shed.empty() and overhead + shed.back().second < overheadBudget / 2) {
+      passing[shed.back().first] = true;
+      detail::passingVersion++;
+      decide("restore", names[shed.back().first]);
+      shed.pop_back();
+    }
+    else if (shed.empty()) {
+      auto const interval = scaleSamplingInterval(0.5);
+      if (interval.count() > 0)
+        decide("faster-sampling", std::to_string(interval.count()));
+    }
+  }
+
+  lastBudgetDecision = now;
+  budgetRecords = budgetSamples = 0;
+  budgetFlushTime = Event::Clock::duration::zero();
+  std::fill(budgetEventRecords.begin(), budgetEventRecords.end(), 0);
+}
+
+}
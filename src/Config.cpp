@@ -0,0 +1,150 @@
+#include "EventTimings/EventUtils.hpp"
+#include "Lock.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+namespace EventTimings {
+
+namespace {
+
+/// Variables, that are read with the prefix EVENTTIMINGS_ from the environment or without it from the file
+char const * const variables[] = {"ENABLE", "OUTPUT_DIR", "FORMAT", "INCLUDE", "EXCLUDE", "RECORD",
+                                  "SNAPSHOT_INTERVAL", "TELEMETRY_INTERVAL", "THRESHOLD", "THROTTLE_RATE",
+                                  "THROTTLE_OVERHEAD", "BUDGET", "CRASH_DUMP", "COLLECT"};
+
+std::string trim(std::string const & s)
+{
+  auto const first = s.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos)
+    return "";
+  return s.substr(first, s.find_last_not_of(" \t\r\n") - first + 1);
+}
+
+std::string upper(std::string s)
+{
+  std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::toupper(c); });
+  return s;
+}
+
+/// Reads lines "key = value" into settings, keys are case-insensitive, # starts a comment
+void readFile(std::string const & path, std::map<std::string, std::string> & settings)
+{
+  std::ifstream in(path);
+  if (not in) {
+    std::cerr << "EventTimings: Cannot read configuration file " << path << std::endl;
+    return;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    line = trim(line.substr(0, line.find('#')));
+    auto const equals = line.find('=');
+    if (line.empty() or equals == std::string::npos)
+      continue;
+    settings[upper(trim(line.substr(0, equals)))] = trim(line.substr(equals + 1));
+  }
+}
+
+}
+
+void EventRegistry::configure()
+{
+  std::map<std::string, std::string> settings;
+  if (char const * path = std::getenv("EVENTTIMINGS_CONFIG"))
+    readFile(path, settings);
+  for (auto variable : variables)
+    if (char const * value = std::getenv((std::string("EVENTTIMINGS_") + variable).c_str()))
+      settings[variable] = value;
+
+  auto const isTrue = [](std::string const & value) {
+    auto const v = upper(value);
+    return not (v == "0" or v == "OFF" or v == "FALSE" or v == "NO");
+  };
+
+  for (auto const & setting : settings) {
+    auto const & key = setting.first;
+    auto const & value = setting.second;
+    if (key == "ENABLE")
+      enabled = isTrue(value);
+    else if (key == "COLLECT")
+      collectRanks = isTrue(value);
+    else if (key == "CRASH_DUMP")
+      crashDump = isTrue(value);
+    else if (key == "OUTPUT_DIR")
+      outputDirectory = value;
+    else if (key == "FORMAT") {
+      formats.clear();
+      std::istringstream list(value);
+      std::string format;
+      while (std::getline(list, format, ','))
+        if (not trim(format).empty())
+          formats.insert(trim(format));
+    }
+    else if (key == "RECORD") {
+      if (value != "all" and value != "aggregate")
+        std::cerr << "EventTimings: Unknown recording policy " << value << ", using all" << std::endl;
+      recordStateChanges = value != "aggregate";
+    }
+    else if (key == "SNAPSHOT_INTERVAL")
+      snapshotInterval = std::chrono::duration<double>(std::atof(value.c_str()));
+    else if (key == "TELEMETRY_INTERVAL")
+      telemetryInterval = std::chrono::duration<double>(std::atof(value.c_str()));
+    else if (key == "THRESHOLD")
+      stateChangeThreshold = std::chrono::duration<double>(std::atof(value.c_str()));
+    else if (key == "THROTTLE_RATE")
+      throttleRate = std::atof(value.c_str());
+    else if (key == "THROTTLE_OVERHEAD")
+      throttleOverhead = std::atof(value.c_str());
+    else if (key == "BUDGET")
+      overheadBudget = std::atof(value.c_str());
+    else if (key != "INCLUDE" and key != "EXCLUDE")
+      std::cerr << "EventTimings: Unknown configuration " << key << std::endl;
+  }
+
+  if (settings.count("INCLUDE") or settings.count("EXCLUDE")) {
+    try {
+      setFilter(settings["INCLUDE"], settings["EXCLUDE"]);
+    }
+    catch (std::regex_error const & e) {
+      std::cerr << "EventTimings: Invalid filter, recording all events: " << e.what() << std::endl;
+      setFilter("", "");
+    }
+  }
+}
+
+void EventRegistry::setFilter(std::string const & include, std::string const & exclude)
+{
+  // Compile first, so invalid expressions leave the filter unchanged
+  std::regex const includeRegex(include), excludeRegex(exclude);
+
+  Lock lock(mutex);
+  this->include = includeRegex;
+  this->exclude = excludeRegex;
+  hasInclude = not include.empty();
+  hasExclude = not exclude.empty();
+  for (size_t id = 0; id < names.size(); ++id)
+    passing[id] = passesFilter(names[id]);
+  detail::passingVersion++;
+}
+
+bool EventRegistry::isRecorded(int id)
+{
+  Lock lock(mutex);
+  return enabled and passing[id];
+}
+
+bool EventRegistry::passesFilter(std::string const & name) const
+{
+  if (name == globalEvent.name)
+    return true;
+  if (hasInclude and not std::regex_search(name, include))
+    return false;
+  return not (hasExclude and std::regex_search(name, exclude));
+}
+
+}
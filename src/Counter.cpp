@@ -0,0 +1,90 @@
+#include "EventTimings/Counter.hpp"
+
+#include <utility>
+
+namespace EventTimings {
+
+Counter::Counter(std::string name, size_t capacity)
+  : name(std::move(name)),
+    capacity(capacity)
+{}
+
+void Counter::record(double value)
+{
+  auto const now = Event::Clock::now().time_since_epoch().count();
+  // Growing the series is not counted as allocation of the running event
+  bool const wasUntracked = detail::untracked;
+  detail::untracked = true;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pendingCount == 0)
+      pendingTimestamp = now;
+    pendingSum += value;
+    if (++pendingCount >= stride) {
+      series.timestamps.push_back(pendingTimestamp);
+      series.values.push_back(pendingSum / pendingCount);
+      pendingCount = 0;
+      pendingSum = 0;
+      if (capacity > 0 and series.values.size() > capacity)
+        downsample();
+    }
+  }
+  detail::untracked = wasUntracked;
+}
+
+void Counter::setCapacity(size_t capacity)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  this->capacity = capacity;
+  while (capacity > 0 and series.values.size() > capacity)
+    downsample();
+}
+
+std::string const & Counter::getName() const
+{
+  return name;
+}
+
+CounterSeries Counter::getSeries() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  CounterSeries result = series;
+  if (pendingCount > 0) {
+    result.timestamps.push_back(pendingTimestamp);
+    result.values.push_back(pendingSum / pendingCount);
+  }
+  return result;
+}
+
+void Counter::clear()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  series.timestamps.clear();
+  series.values.clear();
+  stride = 1;
+  pendingCount = 0;
+  pendingSum = 0;
+}
+
+void Counter::downsample()
+{
+  auto & ts = series.timestamps;
+  auto & vs = series.values;
+  size_t const pairs = vs.size() / 2;
+  for (size_t i = 0; i < pairs; ++i) {
+    ts[i] = ts[2 * i];
+    vs[i] = (vs[2 * i] + vs[2 * i + 1]) / 2;
+  }
+  // An odd last sample averages only half as many values, its values are carried forward into the pending sample,
+  // which holds fewer values than a sample, so it is not averaged twice
+  if (vs.size() % 2) {
+    pendingTimestamp = ts.back();
+    pendingSum += vs.back() * stride;
+    pendingCount += stride;
+  }
+  ts.resize(pairs);
+  vs.resize(pairs);
+  stride *= 2;
+}
+
+}
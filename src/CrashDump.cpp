@@ -0,0 +1,378 @@
+#include "EventTimings/EventUtils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace EventTimings {
+
+namespace {
+
+using sys_clk  = std::chrono::system_clock;
+using stdy_clk = std::chrono::steady_clock;
+
+constexpr char dumpMagic[8] = "ETCRASH";
+constexpr std::uint32_t dumpVersion = 2;
+
+// The dump calls the kernel directly, as open, write and close may be interposed, e.g., by EventTimingsIO, whose
+// hooks lock the registry and allocate.
+
+int rawOpen(char const * path)
+{
+  return syscall(SYS_openat, AT_FDCWD, path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+}
+
+ssize_t rawWrite(int fd, void const * data, size_t size)
+{
+  return syscall(SYS_write, fd, data, size);
+}
+
+void rawClose(int fd)
+{
+  syscall(SYS_close, fd);
+}
+
+/// Set while a dump is written, so a signal raised meanwhile does not dump again
+std::atomic<bool> dumping{false};
+
+/// Packs values into a buffer on the stack and writes it by the write system call, so it is async-signal-safe
+class DumpWriter
+{
+public:
+  explicit DumpWriter(int fd) : fd(fd) {}
+
+  ~DumpWriter() { flush(); }
+
+  template<class T>
+  void put(T value)
+  {
+    bytes(&value, sizeof(T));
+  }
+
+  void bytes(void const * data, size_t size)
+  {
+    auto const * from = static_cast<char const *>(data);
+    while (size > 0) {
+      if (used == sizeof(buffer))
+        flush();
+      size_t const n = std::min(size, sizeof(buffer) - used);
+      std::memcpy(buffer + used, from, n);
+      used += n;
+      from += n;
+      size -= n;
+    }
+  }
+
+  void string(std::string const & s)
+  {
+    put(static_cast<std::uint32_t>(s.size()));
+    bytes(s.data(), s.size());
+  }
+
+  void flush()
+  {
+    char const * from = buffer;
+    while (used > 0) {
+      ssize_t const written = rawWrite(fd, from, used);
+      if (written < 0 and errno == EINTR)
+        continue;
+      if (written <= 0)
+        break;
+      from += written;
+      used -= written;
+    }
+    used = 0;
+  }
+
+private:
+  int fd;
+  size_t used = 0;
+  char buffer[4096];
+};
+
+/// Reads the values packed by DumpWriter
+class DumpReader
+{
+public:
+  explicit DumpReader(std::string const & file) : in(file, std::ios::binary) {}
+
+  template<class T>
+  T get()
+  {
+    T value{};
+    in.read(reinterpret_cast<char *>(&value), sizeof(T));
+    return value;
+  }
+
+  std::string string()
+  {
+    std::string s(get<std::uint32_t>(), '\0');
+    in.read(&s[0], s.size());
+    return s;
+  }
+
+  bool good() const { return in.good(); }
+
+private:
+  std::ifstream in;
+};
+
+/// Actions of the signals before installCrashHandler, indexed by signal
+struct sigaction previousActions[NSIG];
+
+void crashHandler(int signal, siginfo_t * info, void * context)
+{
+  EventRegistry::instance().signal_handler(signal);
+
+  // Restores the previous action, so it also handles further signals, and chains to it
+  struct sigaction const & previous = previousActions[signal];
+  sigaction(signal, &previous, nullptr);
+  if (previous.sa_flags & SA_SIGINFO)
+    previous.sa_sigaction(signal, info, context);
+  else if (previous.sa_handler == SIG_DFL)
+    raise(signal); // Not blocked by SA_NODEFER, so it terminates here
+  else if (previous.sa_handler != SIG_IGN)
+    previous.sa_handler(signal);
+}
+
+}
+
+void EventRegistry::installCrashHandler()
+{
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_sigaction = crashHandler;
+  action.sa_flags = SA_SIGINFO | SA_NODEFER;
+  sigemptyset(&action.sa_mask);
+  for (int signal : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT, SIGTERM}) {
+    struct sigaction previous;
+    sigaction(signal, &action, &previous);
+    // Installing again, e.g., by a second initialize, keeps the action before the first install
+    if (not (previous.sa_flags & SA_SIGINFO and previous.sa_sigaction == crashHandler))
+      previousActions[signal] = previous;
+  }
+}
+
+void EventRegistry::signal_handler(int signal)
+{
+  if (not initialized or dumping.exchange(true))
+    return;
+
+  // Both clocks read clock_gettime, which is async-signal-safe
+  auto const crashedAt = sys_clk::now();
+  auto const crashedAtTicks = stdy_clk::now();
+
+  int const fd = rawOpen(crashDumpFile.c_str());
+  if (fd == -1) {
+    dumping = false;
+    return;
+  }
+
+  {
+    DumpWriter out(fd);
+    out.bytes(dumpMagic, sizeof(dumpMagic));
+    out.put(dumpVersion);
+    out.put<std::int32_t>(commRank);
+    out.put<std::int32_t>(signal);
+    out.string(applicationName);
+    out.string(runName);
+    out.put<std::int64_t>(localRankData.initializedAt.time_since_epoch().count());
+    out.put<std::int64_t>(localRankData.getInitializedAtTicks().time_since_epoch().count());
+    out.put<std::int64_t>(crashedAt.time_since_epoch().count());
+    out.put<std::int64_t>(crashedAtTicks.time_since_epoch().count());
+    out.put(localRankData.transitionCost);
+
+    out.put(static_cast<std::uint32_t>(names.size()));
+    for (auto const & name : names)
+      out.string(name);
+
+    std::uint32_t events = 0;
+    for (auto ed : eventData)
+      events += ed != nullptr;
+    out.put(events);
+    for (size_t id = 0; id < eventData.size(); ++id) {
+      EventData const * ed = eventData[id];
+      if (ed == nullptr)
+        continue;
+      out.put<std::int32_t>(id);
+      out.put<std::int64_t>(ed->getCount());
+      out.put<std::int64_t>(ed->total.count());
+      out.put<std::int64_t>(ed->max.count());
+      out.put<std::int64_t>(ed->min.count());
+      out.put<std::int64_t>(ed->transitions);
+      out.put<std::int64_t>(ed->untraced);
+      out.put<std::uint8_t>(ed->throttled);
+      out.put<std::uint64_t>(ed->stateChanges.size());
+      for (size_t i = 0; i < ed->stateChanges.size(); ++i) {
+        out.put<std::int32_t>(static_cast<int>(ed->stateChanges[i].first));
+        out.put<std::int64_t>(ed->stateChanges[i].second.time_since_epoch().count());
+        out.put<std::int32_t>(i < ed->stateChangeThreads.size() ? ed->stateChangeThreads[i] : 0);
+      }
+    }
+
+    auto const & nodes = localRankData.callTree.nodes;
+    out.put(static_cast<std::uint32_t>(nodes.size()));
+    for (auto const & node : nodes) {
+      out.string(node.name);
+      out.put<std::int32_t>(node.parent);
+      out.put<std::int64_t>(node.count);
+      out.put<std::int64_t>(node.inclusive.count());
+      out.put<std::int64_t>(node.transitions);
+    }
+
+    out.put(static_cast<std::uint32_t>(threads.size()));
+    for (auto const & thread : threads) {
+      out.put<std::int32_t>(thread->buffer.thread);
+      out.put(static_cast<std::uint32_t>(thread->running.size()));
+      for (auto const & r : thread->running) {
+        out.put<std::int32_t>(r.id);
+        out.put<std::int32_t>(r.node);
+        out.put<std::int64_t>(r.start);
+        out.put<std::uint8_t>(r.traced);
+      }
+      int const size = std::min(std::max(thread->buffer.size, 0), detail::Buffer::capacity);
+      out.put(static_cast<std::uint32_t>(size));
+      for (int i = 0; i < size; ++i) {
+        auto const & record = thread->buffer.records[i];
+        out.put<std::int32_t>(record.id);
+        out.put<std::int32_t>(static_cast<int>(record.transition));
+        out.put<std::int64_t>(record.timestamp);
+        out.put<std::int64_t>(record.duration);
+      }
+    }
+  }
+  rawClose(fd);
+  dumping = false;
+}
+
+bool EventRegistry::readCrashDumps(std::vector<std::string> const & files)
+{
+  using detail::Transition;
+  clear();
+
+  std::vector<RankData> ranks;
+  std::vector<bool> dumped;
+  for (auto const & file : files) {
+    DumpReader in(file);
+    char magic[sizeof(dumpMagic)] = {};
+    for (auto & c : magic)
+      c = in.get<char>();
+    if (not in.good() or std::memcmp(magic, dumpMagic, sizeof(dumpMagic)) != 0
+        or in.get<std::uint32_t>() != dumpVersion) {
+      std::cerr << "EventTimings: " << file << " is no crash dump of this version" << std::endl;
+      continue;
+    }
+    int const rank = in.get<std::int32_t>();
+    int const signal = in.get<std::int32_t>();
+    applicationName = in.string();
+    runName = in.string();
+    auto const initializedAt = sys_clk::time_point(sys_clk::duration(in.get<std::int64_t>()));
+    auto const initializedAtTicks = stdy_clk::time_point(stdy_clk::duration(in.get<std::int64_t>()));
+    auto const crashedAt = sys_clk::time_point(sys_clk::duration(in.get<std::int64_t>()));
+    auto const crashedAtTicks = in.get<std::int64_t>();
+
+    localRankData.clear();
+    eventData.clear();
+    childNodes.clear();
+    localRankData.initialize(initializedAt, initializedAtTicks);
+    localRankData.finalize(crashedAt, stdy_clk::time_point(stdy_clk::duration(crashedAtTicks)));
+    localRankData.transitionCost = in.get<double>();
+
+    // Ids of the dump -> ids of this registry
+    std::vector<int> mapped(in.get<std::uint32_t>());
+    for (auto & id : mapped) {
+      bool recorded;
+      id = getId(in.string(), recorded);
+    }
+    auto const mapId = [&](int id) { return id >= 0 and static_cast<size_t>(id) < mapped.size() ? mapped[id] : 0; };
+
+    for (auto events = in.get<std::uint32_t>(); events > 0 and in.good(); --events) {
+      int const id = mapId(in.get<std::int32_t>());
+      long const count = in.get<std::int64_t>();
+      EventData restored(names[id], count, 0, 0, 0, {}, {});
+      restored.total = Event::Clock::duration(in.get<std::int64_t>());
+      restored.max = Event::Clock::duration(in.get<std::int64_t>());
+      restored.min = Event::Clock::duration(in.get<std::int64_t>());
+      restored.transitions = in.get<std::int64_t>();
+      restored.untraced = in.get<std::int64_t>();
+      restored.throttled = in.get<std::uint8_t>();
+      restored.stateChanges.resize(in.get<std::uint64_t>());
+      restored.stateChangeThreads.resize(restored.stateChanges.size());
+      for (size_t i = 0; i < restored.stateChanges.size(); ++i) {
+        restored.stateChanges[i].first = static_cast<Event::State>(in.get<std::int32_t>());
+        restored.stateChanges[i].second = Event::Clock::time_point(Event::Clock::duration(in.get<std::int64_t>()));
+        restored.stateChangeThreads[i] = in.get<std::int32_t>();
+      }
+      getEventData(id) = std::move(restored);
+    }
+
+    // Nodes are restored in order, so their indices are the same
+    auto & tree = localRankData.callTree;
+    auto const nodes = in.get<std::uint32_t>();
+    for (std::uint32_t n = 0; n < nodes and in.good(); ++n) {
+      auto const name = in.string();
+      int const parent = in.get<std::int32_t>();
+      int const node = n == 0 ? 0 : tree.child(std::max(parent, 0), name);
+      tree.nodes[node].count = in.get<std::int64_t>();
+      tree.nodes[node].inclusive = Event::Clock::duration(in.get<std::int64_t>());
+      tree.nodes[node].transitions = in.get<std::int64_t>();
+    }
+
+    for (auto count = in.get<std::uint32_t>(); count > 0 and in.good(); --count) {
+      std::unique_ptr<Thread> thread(new Thread);
+      thread->buffer.thread = in.get<std::int32_t>();
+      thread->running.resize(in.get<std::uint32_t>());
+      for (auto & r : thread->running) {
+        r.id = mapId(in.get<std::int32_t>());
+        r.node = in.get<std::int32_t>();
+        r.start = in.get<std::int64_t>();
+        r.traced = in.get<std::uint8_t>();
+      }
+      thread->buffer.size = std::min<std::uint32_t>(in.get<std::uint32_t>(), detail::Buffer::capacity);
+      for (int i = 0; i < thread->buffer.size; ++i) {
+        auto & record = thread->buffer.records[i];
+        record.id = mapId(in.get<std::int32_t>());
+        record.transition = static_cast<Transition>(in.get<std::int32_t>());
+        record.timestamp = in.get<std::int64_t>();
+        record.duration = in.get<std::int64_t>();
+      }
+      replay(*thread);
+
+      // Stop the events, that were running at the crash, innermost first
+      thread->buffer.size = 0;
+      for (auto r = thread->running.rbegin(); r != thread->running.rend(); ++r)
+        thread->buffer.records[thread->buffer.size++] = {r->id, Transition::Stop, crashedAtTicks, crashedAtTicks - r->start};
+      replay(*thread);
+      deliverRuns();
+    }
+
+    if (not in.good()) {
+      std::cerr << "EventTimings: Crash dump " << file << " is truncated" << std::endl;
+      continue;
+    }
+    std::cerr << "EventTimings: Read crash dump of rank " << rank << ", signal " << signal << std::endl;
+
+    if (static_cast<size_t>(rank) >= ranks.size()) {
+      ranks.resize(rank + 1);
+      dumped.resize(rank + 1, false);
+    }
+    ranks[rank] = localRankData;
+    dumped[rank] = true;
+  }
+
+  localRankData.clear();
+  eventData.clear();
+  childNodes.clear();
+  return setGlobalRankData(std::move(ranks), dumped);
+}
+
+}
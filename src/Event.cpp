@@ -3,11 +3,76 @@
 
 namespace EventTimings  {
 
+namespace detail {
+
+// Definitions of the constants, that are bound to references, e.g., by std::min
+constexpr int Buffer::capacity;
+constexpr int Buffer::maxDepth;
+constexpr unsigned Buffer::sampleCapacity;
+
+thread_local Buffer * buffer = nullptr;
+
+bool probing = false;
+
+thread_local bool untracked = false;
+
+std::atomic<unsigned> passingVersion{0};
+
+struct ThreadExit
+{
+  ~ThreadExit()
+  {
+    Buffer * const b = buffer;
+    buffer = nullptr; // before the release, so the sampling handler does not append to it anymore
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    EventRegistry::instance().releaseThread(*b);
+  }
+};
+
+namespace {
+
+/// Releases the buffer of the thread, when it exits, so threads, that come and go, reuse the buffers
+thread_local ThreadExit threadExit;
+
+}
+
+Buffer * overflow()
+{
+  if (buffer == nullptr) {
+    buffer = EventRegistry::instance().registerThread();
+    (void) &threadExit; // Constructs it, so it is destroyed at the exit of the thread
+  }
+  else
+    EventRegistry::instance().flush(*buffer);
+  return buffer;
+}
+
+void leaveNested(int id)
+{
+  int const depth = std::min(buffer->depth, Buffer::maxDepth);
+  for (int i = depth - 1; i >= 0; --i) {
+    if (buffer->running[i] == id) {
+      std::copy(buffer->running + i + 1, buffer->running + depth, buffer->running + i);
+      buffer->depth--;
+      return;
+    }
+  }
+  // The event is nested deeper than maxDepth
+  if (buffer->depth > Buffer::maxDepth)
+    buffer->depth--;
+}
+
+}
+
+// -----------------------------------------------------------------------
+
 Event::Event(std::string eventName, Clock::duration initialDuration)
   : name(EventRegistry::instance().prefix + eventName),
     duration(initialDuration)
 {
-  EventRegistry::instance().put(*this);
+  id = EventRegistry::instance().getId(name, recorded);
+  if (recorded)
+    EventRegistry::instance().put(*this);
 }
 
 Event::Event(std::string eventName, bool barrier, bool autostart)
@@ -15,68 +80,66 @@ Event::Event(std::string eventName, bool barrier, bool autostart)
     _barrier(barrier)
 {
   // Set prefix here: workaround to omit data lock between instance() and Event ctor
-  if (eventName != "_GLOBAL")
+  // The id of _GLOBAL is set by the EventRegistry.
+  if (eventName != "_GLOBAL") {
     name = EventRegistry::instance().prefix + eventName;
+    version = detail::passingVersion.load(std::memory_order_relaxed);
+    id = EventRegistry::instance().getId(name, recorded);
+  }
   if (autostart) {
     start(_barrier);
   }
 }
 
-Event::~Event()
+void Event::addData(std::string key, int value)
 {
-  stop(_barrier);
+  data[key].push_back(value);
 }
 
-void Event::start(bool barrier)
+void Event::synchronize()
 {
-  if (barrier)
-    MPI_Barrier(EventRegistry::instance().getMPIComm());
-
-  state = State::STARTED;
-  stateChanges.push_back(std::make_pair(State::STARTED, Clock::now()));
-  starttime = Clock::now();
+  // All ranks share the configuration, so disabling skips the barriers on all ranks
+  if (not EventRegistry::instance().enabled)
+    return;
+  auto const entered = Clock::now();
+  MPI_Barrier(EventRegistry::instance().getMPIComm());
+  if (recorded)
+    EventRegistry::instance().putBarrierWait(id, Clock::now() - entered);
 }
 
-void Event::stop(bool barrier)
+void Event::updateRecorded()
 {
-  if (state == State::STARTED or state == State::PAUSED) {
-    if (barrier)
-      MPI_Barrier(EventRegistry::instance().getMPIComm());
+  version = detail::passingVersion.load(std::memory_order_relaxed);
+  recorded = EventRegistry::instance().isRecorded(id);
+}
 
-    if (state == State::STARTED) {
-      auto stoptime = Clock::now();
-      duration += Clock::duration(stoptime - starttime);
-    }
-    stateChanges.push_back(std::make_pair(State::STOPPED, Clock::now()));
-    state = State::STOPPED;
-    EventRegistry::instance().put(*this);
-    data.clear();
-    stateChanges.clear();
-    duration = Clock::duration::zero();
-  }
+void Event::commitData()
+{
+  EventRegistry::instance().putData(id, data);
+  data.clear();
 }
 
-void Event::pause(bool barrier)
+void Event::startProbes()
 {
-  if (state == State::STARTED) {
-    if (barrier)
-      MPI_Barrier(EventRegistry::instance().getMPIComm());
-
-    auto stoptime = Clock::now();
-    stateChanges.emplace_back(State::PAUSED, Clock::now());
-    state = State::PAUSED;
-    duration += Clock::duration(stoptime - starttime);
-  }
+  EventRegistry::instance().readProbes(probeStart);
 }
 
-Event::Clock::duration Event::getDuration() const
+void Event::stopProbes()
 {
-  return duration;
+  static thread_local std::vector<long long> current;
+  EventRegistry::instance().readProbes(current);
+  if (probeStart.size() != current.size()) // A probe was added while running
+    return;
+
+  probeValues.resize(current.size(), 0);
+  for (size_t i = 0; i < current.size(); ++i)
+    probeValues[i] += current[i] - probeStart[i];
 }
 
-void Event::addData(std::string key, int value)
+void Event::commitProbes()
 {
-  data[key].push_back(value);
+  EventRegistry::instance().putProbeValues(id, probeValues);
+  probeValues.clear();
 }
 
 // -----------------------------------------------------------------------
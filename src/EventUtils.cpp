@@ -1,7 +1,12 @@
 #include "EventTimings/EventUtils.hpp"
+#include "EventTimings/Memory.hpp"
+#include "Lock.hpp"
 #include "json.hpp"
 
+#include <array>
 #include <cassert>
+#include <cstdio>
+#include <cstdint>
 #include <algorithm>
 #include <iostream>
 #include <iomanip>
@@ -9,6 +14,13 @@
 #include <string>
 #include <sstream>
 #include <ctime>
+#include <iterator>
+#include <limits>
+#include <set>
+#include <sys/stat.h>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 #include "prettyprint.hpp"
 #include "TableWriter.hpp"
@@ -37,6 +49,17 @@ template<typename A, typename B> double divOrZero(A a, B b)
     return a / b;
 }
 
+namespace {
+
+/// Returns the value of a metric, zero if it was not recorded
+double metricOrZero(std::map<std::string, double> const & metrics, std::string const & name)
+{
+  auto found = metrics.find(name);
+  return found == metrics.end() ? 0.0 : found->second;
+}
+
+}
+
 /// Converts the time_point into a string like "2019-01-10T18:30:46.834"
 std::string timepoint_to_string(sys_clk::time_point c)
 {
@@ -65,6 +88,9 @@ std::map<std::string, GlobalEventStats> getGlobalStats(std::vector<RankData> eve
         stats.min = event.min;
         stats.minRank = rank;
       }
+      stats.total += event.total;
+      for (auto const & metric : event.metrics)
+        stats.metrics[metric.first] += metric.second;
     }
   }
   return globalStats;
@@ -75,8 +101,16 @@ struct MPI_EventData
 {
   char name[255] = {'\0'};
   int count = 0;
-  long total = 0, max = 0, min = 0;
-  int dataSize = 0, stateChangesSize = 0;
+  long total = 0, max = 0, min = 0, transitions = 0, untraced = 0;
+  int dataSize = 0, stateChangesSize = 0, metricsSize = 0, sentSize = 0, throttled = 0;
+};
+
+
+struct MPI_CallNode
+{
+  char name[255] = {'\0'};
+  int parent = -1;
+  long count = 0, inclusive = 0, transitions = 0;
 };
 
 
@@ -99,18 +133,26 @@ EventData::EventData(std::string _name, long _count, long _total, long _max, lon
 
 
 void EventData::put(Event const & event)
+{
+  put(event.getDuration());
+  addData(event.data);
+}
+
+void EventData::put(Event::Clock::duration duration)
 {
   count++;
-  stdy_clk::duration duration = event.getDuration();
   total += duration;
   min = std::min(duration, min);
   max = std::max(duration, max);
-  for (auto const & d : event.data) {
+}
+
+void EventData::addData(Event::Data const & eventData)
+{
+  for (auto const & d : eventData) {
     auto & source = std::get<1>(d);
     auto & target = data[std::get<0>(d)];
     target.insert(target.begin(), source.begin(), source.end());
   }
-  stateChanges.insert(std::end(stateChanges), std::begin(event.stateChanges), std::end(event.stateChanges));
 }
 
 std::string EventData::getName() const
@@ -150,6 +192,113 @@ Event::Data const & EventData::getData() const
 
 
 
+// -----------------------------------------------------------------------
+
+CallTree::Node::Node(std::string name, int parent)
+  : name(std::move(name)),
+    parent(parent)
+{}
+
+
+CallTree::CallTree()
+{
+  nodes.emplace_back("", -1);
+}
+
+
+int CallTree::child(int parent, std::string const & name)
+{
+  auto & children = nodes[parent].children;
+  auto found = children.find(name);
+  if (found != children.end())
+    return found->second;
+
+  int index = nodes.size();
+  children.emplace(name, index); // insert before emplace_back, it invalidates children
+  nodes.emplace_back(name, parent);
+  return index;
+}
+
+
+Event::Clock::duration CallTree::getExclusive(int node) const
+{
+  auto exclusive = nodes[node].inclusive;
+  for (auto const & c : nodes[node].children)
+    exclusive -= nodes[c.second].inclusive;
+
+  // Events, that are not properly nested, may run longer than their parent
+  return std::max(exclusive, Event::Clock::duration::zero());
+}
+
+
+void CallTree::traverse(std::function<void(int node, int depth)> const & visitor) const
+{
+  traverse(0, 0, visitor);
+}
+
+
+void CallTree::traverse(int node, int depth, std::function<void(int, int)> const & visitor) const
+{
+  if (node != 0)
+    visitor(node, depth);
+
+  for (int c : getChildren(node))
+    traverse(c, depth + 1, visitor);
+}
+
+
+std::vector<int> CallTree::getChildren(int node) const
+{
+  std::map<std::string, int> sorted(nodes[node].children.begin(), nodes[node].children.end());
+  std::vector<int> children;
+  for (auto const & c : sorted)
+    children.push_back(c.second);
+  return children;
+}
+
+
+void CallTree::merge(CallTree const & other)
+{
+  // Maps node indices of other to node indices of this, parents are mapped before their children
+  std::vector<int> mapped(other.nodes.size(), 0);
+  for (size_t n = 1; n < other.nodes.size(); ++n) {
+    auto const & node = other.nodes[n];
+    mapped[n] = child(mapped[node.parent], node.name);
+    nodes[mapped[n]].count += node.count;
+    nodes[mapped[n]].inclusive += node.inclusive;
+    nodes[mapped[n]].transitions += node.transitions;
+  }
+}
+
+
+void CallTree::writeFolded(std::ostream & out, std::string const & prefix) const
+{
+  // Holds the path of the visited node, it is truncated to the path of the parent on each visit.
+  std::string path = prefix;
+  std::vector<size_t> pathLengths = {path.size()};
+  traverse([&](int node, int depth) {
+      pathLengths.resize(depth);
+      path.resize(pathLengths.back());
+      if (depth > 1 or not prefix.empty())
+        path += ';';
+      auto const & name = nodes[node].name;
+      std::replace_copy(name.begin(), name.end(), std::back_inserter(path), ';', ',');
+      pathLengths.push_back(path.size());
+
+      auto const exclusive = std::chrono::duration_cast<std::chrono::nanoseconds>(getExclusive(node));
+      if (exclusive.count() > 0)
+        out << path << ' ' << exclusive.count() << '\n';
+    });
+}
+
+
+void CallTree::clear()
+{
+  nodes.clear();
+  nodes.emplace_back("", -1);
+}
+
+
 // -----------------------------------------------------------------------
 
 void RankData::initialize()
@@ -167,6 +316,26 @@ void RankData::finalize()
 }
 
 
+void RankData::initialize(sys_clk::time_point at, stdy_clk::time_point ticks)
+{
+  initializedAt = at;
+  initializedAtTicks = ticks;
+  isFinalized = false;
+}
+
+void RankData::finalize(sys_clk::time_point at, stdy_clk::time_point ticks)
+{
+  finalizedAt = at;
+  finalizedAtTicks = ticks;
+  isFinalized = true;
+}
+
+stdy_clk::time_point RankData::getInitializedAtTicks() const
+{
+  return initializedAtTicks;
+}
+
+
 void RankData::put(Event const & event)
 {
   /// Constructs or returns EventData object with name as key and name as arg to ctor.
@@ -195,11 +364,103 @@ void RankData::normalizeTo(sys_clk::time_point t0)
       assert(tp.time_since_epoch().count() > 0); // Trying to do normalize twice?
     }
   }
+  for (auto & counter : counters)
+    for (auto & ts : counter.second.timestamps)
+      ts = (stdy_clk::duration(ts) - initializedAtTicks.time_since_epoch() + delta).count();
+}
+
+void RankData::compensateOverhead()
+{
+  if (compensated)
+    return;
+
+  auto & nodes = callTree.nodes;
+  // Transitions of each node and all its descendants, children have higher indices than their parents
+  std::vector<long> subtreeTransitions(nodes.size(), 0);
+  for (size_t n = nodes.size() - 1; n > 0; --n) {
+    subtreeTransitions[n] += nodes[n].transitions;
+    subtreeTransitions[nodes[n].parent] += subtreeTransitions[n];
+  }
+
+  for (size_t n = 1; n < nodes.size(); ++n) {
+    auto const overhead = std::chrono::duration_cast<stdy_clk::duration>(
+      std::chrono::duration<double, std::nano>(subtreeTransitions[n] * transitionCost));
+    nodes[n].inclusive = std::max(nodes[n].inclusive - overhead, stdy_clk::duration::zero());
+
+    // The overhead of a recursive or nested run of the same name is part of the subtree of the outermost one
+    bool nested = false;
+    for (size_t a = nodes[n].parent; a > 0 and not nested; a = nodes[a].parent)
+      nested = nodes[a].name == nodes[n].name;
+    if (nested)
+      continue;
+    auto ev = evData.find(nodes[n].name);
+    if (ev != evData.end())
+      ev->second.total = std::max(ev->second.total - overhead, stdy_clk::duration::zero());
+  }
+  compensated = true;
+}
+
+double RankData::getOverhead() const
+{
+  long transitions = 0;
+  for (auto const & ev : evData)
+    transitions += ev.second.transitions;
+  return transitions * transitionCost / 1e6;
+}
+
+std::vector<TimelineEntry> RankData::timeline() const
+{
+  // Runs of state changes, that are sorted by time, usually one per event
+  struct Run
+  {
+    EventData const * event;
+    size_t next, end;
+  };
+  std::vector<Run> runs;
+  size_t size = 0;
+  for (auto const & ev : evData) {
+    auto const & changes = ev.second.stateChanges;
+    size += changes.size();
+    for (size_t begin = 0, i = 1; begin < changes.size(); ++i) {
+      if (i == changes.size() or changes[i].second < changes[i - 1].second) {
+        runs.push_back({&ev.second, begin, i});
+        begin = i;
+      }
+    }
+  }
+
+  // Heap of the runs by their next state change, the earliest on top, ties in the order of the runs
+  auto const later = [&runs](size_t a, size_t b) {
+    auto const ta = runs[a].event->stateChanges[runs[a].next].second;
+    auto const tb = runs[b].event->stateChanges[runs[b].next].second;
+    return ta > tb or (ta == tb and a > b);
+  };
+  std::vector<size_t> heap(runs.size());
+  for (size_t i = 0; i < heap.size(); ++i)
+    heap[i] = i;
+  std::make_heap(heap.begin(), heap.end(), later);
+
+  std::vector<TimelineEntry> timeline;
+  timeline.reserve(size);
+  while (not heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), later);
+    auto & run = runs[heap.back()];
+    auto const & sc = run.event->stateChanges[run.next++];
+    timeline.push_back({run.event, sc.first, sc.second});
+    if (run.next == run.end)
+      heap.pop_back();
+    else
+      std::push_heap(heap.begin(), heap.end(), later);
+  }
+  return timeline;
 }
 
 void RankData::clear()
 {
   evData.clear();
+  callTree.clear();
+  counters.clear();
+  decisions.clear();
 }
 
 sys_clk::duration RankData::getDuration() const
@@ -227,46 +488,613 @@ void EventRegistry::initialize(std::string applicationName, std::string runName,
   this->runName = runName;
   this->comm = comm;
 
+  if (not enabled)
+    return;
+  MPI_Comm_rank(comm, &commRank);
+  createOutputDirectory();
+  addFormatSinks();
+
+  calibrate(); // before initialize, so it does not count as runtime
   localRankData.initialize();
 
   globalEvent.start(false);
-  initialized = true;
+  lastSnapshot = lastBudgetDecision = lastTelemetry = Event::Clock::now();
+  crashDumpFile = getOutputBase() + ".rank" + std::to_string(commRank) + ".crash";
+  if (crashDump)
+    installCrashHandler();
+  if (telemetryInterval.count() > 0)
+    openTelemetry();
+
+  flushInterval = Event::Clock::duration::zero();
+  auto const budget = overheadBudget > 0 ? budgetInterval : std::chrono::duration<double>::zero();
+  for (auto interval : {snapshotInterval, telemetryInterval, budget}) {
+    auto const ticks = std::chrono::duration_cast<Event::Clock::duration>(interval);
+    if (ticks.count() > 0 and (flushInterval.count() == 0 or ticks < flushInterval))
+      flushInterval = ticks;
+  }
+  {
+    // Threads, that recorded events before, flush at their next stop and get their deadline then
+    Lock lock(mutex);
+    initialized = true;
+    for (auto & thread : threads)
+      thread->buffer.flushAt = 0;
+  }
+  detail::setAllocationHooks(true);
+  detail::setIOHooks(true);
 }
 
 void EventRegistry::finalize()
 {
+  if (not enabled)
+    return;
+
+  {
+    Lock lock(mutex);
+    finalizing = true;
+  }
+  detail::setAllocationHooks(false);
+  detail::setIOHooks(false);
   globalEvent.stop();
   localRankData.finalize();
 
   for (auto & e : storedEvents)
     e.second.stop();
 
-  if (initialized) // this makes only sense when it was properly initialized
-    normalize();
+  stopSampling();
+  flush();
+  closeTelemetry();
+
+  {
+    Lock lock(mutex);
+    for (auto const & counter : counters)
+      localRankData.counters[counter.first] = counter.second->getSeries();
+  }
+
+  if (compensateOverhead)
+    localRankData.compensateOverhead();
+
+  // The ranks are aligned to the rank, that initialized first, which all ranks know after the reduction
+  auto const first = collectRanks and initialized ? findFirstInitialized() : localRankData.initializedAt;
+  auto const delay = std::chrono::duration_cast<Event::Clock::duration>(localRankData.initializedAt - first);
+  for (auto & sink : sinks) {
+    sink->alignRank(commRank, delay);
+    sink->finalizeRank(commRank, localRankData);
+  }
+
+  if (collectRanks) {
+    if (initialized) // this makes only sense when it was properly initialized
+      localRankData.normalizeTo(first);
 
-  collect();
+    collect();
+  }
 
   initialized = false;
+  Lock lock(mutex);
+  finalizing = false;
+  // Drops the calls and messages of the registry itself after the flush, e.g., of collect
+  for (auto & thread : threads) {
+    thread->buffer.calls.clear();
+    thread->buffer.sent.clear();
+    thread->buffer.memory.clear();
+  }
 }
 
 void EventRegistry::clear()
 {
+  storedEvents.clear(); // Stops the events, so do it before the lock
+
+  Lock lock(mutex);
+  for (auto & thread : threads) {
+    thread->buffer.size = 0;
+    thread->buffer.sampleTail.store(thread->buffer.sampleHead.load());
+    thread->buffer.calls.clear();
+    thread->buffer.sent.clear();
+    thread->buffer.memory.clear();
+    thread->running.clear();
+  }
+  for (auto & counter : counters)
+    counter.second->clear();
+  for (auto const & s : shed)
+    passing[s.first] = true;
+  shed.clear();
+  detail::passingVersion++;
   localRankData.clear();
   globalRankData.clear();
-  storedEvents.clear();
+  eventData.clear();
+  childNodes.clear();
+}
+
+void EventRegistry::put(Event const & event)
+{
+  detail::record(event.id, detail::Transition::Given, Event::Clock::now(), event.getDuration());
+  if (not event.data.empty())
+    putData(event.id, event.data);
 }
 
-void EventRegistry::signal_handler(int signal)
+void EventRegistry::putData(int id, Event::Data const & data)
 {
-  if (initialized) {
-    finalize();
-    printAll();
+  Lock lock(mutex);
+  getEventData(id).addData(data);
+}
+
+void EventRegistry::addProbe(std::unique_ptr<Probe> probe)
+{
+  Lock lock(mutex);
+  auto const names = probe->getNames();
+  for (auto const & name : names)
+    probeMetrics.push_back(probe->getGroup() + "." + name);
+  probeSizes.push_back(names.size());
+  probes.push_back(std::move(probe));
+  detail::probing = true;
+}
+
+void EventRegistry::readProbes(std::vector<long long> & values)
+{
+  bool const untracked = detail::untracked;
+  detail::untracked = true; // Probes may read files, e.g. /proc/self/statm
+  values.resize(probeMetrics.size());
+  long long * next = values.data();
+  for (size_t i = 0; i < probes.size(); ++i) {
+    probes[i]->read(next);
+    next += probeSizes[i];
   }
+  detail::untracked = untracked;
 }
 
-void EventRegistry::put(Event const & event)
+void EventRegistry::putProbeValues(int id, std::vector<long long> const & values)
+{
+  Lock lock(mutex);
+  auto & metrics = getEventData(id).metrics;
+  for (size_t i = 0; i < values.size() and i < probeMetrics.size(); ++i)
+    metrics[probeMetrics[i]] += values[i];
+}
+
+int EventRegistry::getCallSlot(std::string const & group, std::string const & call)
+{
+  Lock lock(mutex);
+  std::string const prefix = group + "." + call;
+  auto inserted = callSlotIds.emplace(prefix, callSlots.size());
+  if (inserted.second)
+    callSlots.push_back({group + ".time", group + ".calls", group + ".bytes",
+                         prefix + ".time", prefix + ".calls", prefix + ".bytes"});
+  return inserted.first->second;
+}
+
+void EventRegistry::putCall(int slot, long bytes, Event::Clock::duration duration)
+{
+  int const id = detail::runningEvent(); // the thread has a buffer, if an event is running
+  if (id < 0 or slot < 0)
+    return;
+
+  auto & calls = detail::buffer->calls;
+  if (static_cast<size_t>(id) >= calls.size() or static_cast<size_t>(slot) >= calls[id].size()) {
+    bool const untracked = detail::untracked;
+    detail::untracked = true; // Growing allocates, e.g., within the I/O hook
+    if (static_cast<size_t>(id) >= calls.size())
+      calls.resize(id + 1);
+    if (static_cast<size_t>(slot) >= calls[id].size())
+      calls[id].resize(slot + 1);
+    detail::untracked = untracked;
+  }
+  auto & sums = calls[id][slot];
+  sums.calls++;
+  sums.bytes += bytes;
+  sums.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+void EventRegistry::putMPICall(std::string const & call, long bytes, Event::Clock::duration duration)
+{
+  putCall(getCallSlot("mpi", call), bytes, duration);
+}
+
+void EventRegistry::putIOCall(std::string const & call, long bytes, Event::Clock::duration duration)
+{
+  putCall(getCallSlot("io", call), bytes, duration);
+}
+
+void EventRegistry::mergeCalls(Thread & thread)
+{
+  auto & calls = thread.buffer.calls;
+  for (size_t id = 0; id < calls.size(); ++id) {
+    for (size_t slot = 0; slot < calls[id].size(); ++slot) {
+      auto & sums = calls[id][slot];
+      if (sums.calls == 0)
+        continue;
+      auto const & names = callSlots[slot];
+      auto & metrics = getEventData(id).metrics;
+      metrics[names.groupTime] += sums.nanoseconds;
+      metrics[names.groupCalls] += sums.calls;
+      metrics[names.groupBytes] += sums.bytes;
+      metrics[names.time] += sums.nanoseconds;
+      metrics[names.calls] += sums.calls;
+      metrics[names.bytes] += sums.bytes;
+      sums = detail::CallSums();
+    }
+  }
+
+  auto & sent = thread.buffer.sent;
+  for (size_t id = 0; id < sent.size(); ++id) {
+    if (sent[id].empty())
+      continue;
+    auto & matrix = getEventData(id).sent;
+    for (auto const & peer : sent[id]) {
+      auto & traffic = matrix[peer.first];
+      traffic.bytes += peer.second.bytes;
+      traffic.messages += peer.second.messages;
+    }
+    sent[id].clear();
+  }
+
+  static std::string const allocations = "memory.allocations", allocated = "memory.allocated",
+                           frees = "memory.frees", freed = "memory.freed";
+  auto & memory = thread.buffer.memory;
+  for (size_t id = 0; id < memory.size(); ++id) {
+    auto & sums = memory[id];
+    if (sums.allocations == 0 and sums.frees == 0)
+      continue;
+    auto & metrics = getEventData(id).metrics;
+    metrics[allocations] += sums.allocations;
+    metrics[allocated] += sums.allocated;
+    metrics[frees] += sums.frees;
+    metrics[freed] += sums.freed;
+    sums = detail::MemorySums();
+  }
+}
+
+void EventRegistry::putBarrierWait(int id, Event::Clock::duration wait)
+{
+  double const ns = std::chrono::duration<double, std::nano>(wait).count();
+  Lock lock(mutex);
+  auto & metrics = getEventData(id).metrics;
+  metrics["barrier.count"] += 1;
+  metrics["barrier.wait"] += ns;
+  auto & maxWait = metrics["barrier.max-wait"];
+  maxWait = std::max(maxWait, ns);
+}
+
+void EventRegistry::putMessage(int peer, long bytes)
+{
+  int const id = detail::runningEvent();
+  if (id < 0 or peer < 0)
+    return;
+
+  // Growing allocates, the messages of the registry itself while finalizing are cleared after the flush of finalize
+  bool const untracked = detail::untracked;
+  detail::untracked = true;
+  auto & sent = detail::buffer->sent;
+  if (static_cast<size_t>(id) >= sent.size())
+    sent.resize(id + 1);
+  auto & sums = sent[id][peer];
+  detail::untracked = untracked;
+  sums.bytes += bytes;
+  sums.messages++;
+}
+
+Counter & EventRegistry::counter(std::string const & name)
+{
+  Lock lock(mutex);
+  auto & counter = counters[name];
+  if (not counter)
+    counter.reset(new Counter(name));
+  return *counter;
+}
+
+int EventRegistry::getId(std::string const & name)
+{
+  bool recorded;
+  return getId(name, recorded);
+}
+
+int EventRegistry::getId(std::string const & name, bool & recorded)
+{
+  // Ids of the names, that the thread looked up, and whether they passed the filter at version
+  struct Cached
+  {
+    int id;
+    bool passing;
+    unsigned version;
+  };
+  static thread_local std::unordered_map<std::string, Cached> cache;
+
+  auto found = cache.find(name);
+  if (found == cache.end() or found->second.version != detail::passingVersion.load(std::memory_order_acquire)) {
+    Lock lock(mutex); // also keeps the allocations of the cache untracked
+    auto inserted = ids.emplace(name, names.size());
+    if (inserted.second) {
+      names.push_back(name);
+      passing.push_back(passesFilter(name));
+    }
+    int const id = inserted.first->second;
+    found = cache.emplace(name, Cached()).first;
+    found->second = {id, passing[id] != 0, detail::passingVersion.load(std::memory_order_relaxed)};
+  }
+  recorded = enabled and found->second.passing;
+  return found->second.id;
+}
+
+detail::Buffer * EventRegistry::registerThread()
+{
+  Lock lock(mutex);
+  if (freeThreads.empty()) {
+    threads.emplace_back(new Thread);
+    freeThreads.push_back(threads.size() - 1);
+    threads.back()->buffer.thread = threads.size() - 1;
+  }
+  auto & buffer = threads[freeThreads.back()]->buffer;
+  freeThreads.pop_back();
+  addSampleRing(buffer);
+  scheduleFlush(buffer, Event::Clock::now());
+  return &buffer;
+}
+
+void EventRegistry::releaseThread(detail::Buffer & buffer)
+{
+  {
+    Lock lock(mutex);
+    auto & thread = *threads[buffer.thread];
+    if (initialized) {
+      replay(thread);
+      drainSamples(thread);
+    }
+    buffer.size = 0;
+    buffer.depth = 0;
+    buffer.sampleTail.store(buffer.sampleHead.load());
+    buffer.calls.clear();
+    buffer.sent.clear();
+    buffer.memory.clear();
+    thread.running.clear();
+    freeThreads.push_back(buffer.thread);
+  }
+  deliverRuns();
+}
+
+void EventRegistry::flush(detail::Buffer & buffer)
+{
+  {
+    Lock lock(mutex);
+    auto const start = Event::Clock::now();
+    replay(*threads[buffer.thread]);
+    drainSamples(*threads[buffer.thread]);
+    auto const now = Event::Clock::now();
+    budgetFlushTime += now - start;
+    scheduleFlush(buffer, now);
+    if (initialized and not finalizing) {
+      if (snapshotInterval.count() > 0 and now - lastSnapshot >= snapshotInterval)
+        writeSnapshot();
+      if (telemetry and now - lastTelemetry >= telemetryInterval)
+        publishTelemetry();
+      if (overheadBudget > 0 and now - lastBudgetDecision >= budgetInterval)
+        controlOverhead();
+    }
+  }
+  deliverRuns();
+}
+
+void EventRegistry::scheduleFlush(detail::Buffer & buffer, Event::Clock::time_point now)
 {
-  localRankData.put(event);
+  bool const periodic = initialized and not finalizing and flushInterval.count() > 0;
+  buffer.flushAt = periodic ? (now + flushInterval).time_since_epoch().count()
+                            : std::numeric_limits<Event::Clock::rep>::max();
+}
+
+void EventRegistry::snapshot()
+{
+  {
+    Lock lock(mutex);
+    if (detail::buffer) {
+      replay(*threads[detail::buffer->thread]);
+      drainSamples(*threads[detail::buffer->thread]);
+    }
+    writeSnapshot();
+    if (telemetry)
+      publishTelemetry();
+  }
+  deliverRuns();
+}
+
+void EventRegistry::flush()
+{
+  {
+    Lock lock(mutex);
+    for (auto & thread : threads) {
+      replay(*thread);
+      drainSamples(*thread);
+    }
+  }
+  deliverRuns();
+}
+
+void EventRegistry::deliverRuns()
+{
+  if (not streaming)
+    return;
+  std::vector<PendingRun> runs;
+  // Holding sinkMutex, the runs of concurrent flushes are passed in the order they were replayed
+  std::lock_guard<std::mutex> delivering(sinkMutex);
+  {
+    Lock lock(mutex);
+    runs.swap(pendingRuns);
+  }
+  for (auto const & run : runs) {
+    Run const completed{run.name, commRank, run.thread, run.start, run.stop, run.stopped};
+    for (auto & sink : sinks)
+      if (sink->isStreaming())
+        sink->record(completed);
+  }
+}
+
+void EventRegistry::replay(Thread & thread)
+{
+  using detail::Transition;
+  auto & tree = localRankData.callTree;
+  auto & running = thread.running;
+
+  // Every record is a transition, allocations, calls and messages are summed up apart from the records
+  if (overheadBudget > 0) {
+    budgetRecords += thread.buffer.size;
+    budgetEventRecords.resize(names.size(), 0);
+    for (int i = 0; i < thread.buffer.size; ++i)
+      budgetEventRecords[thread.buffer.records[i].id]++;
+  }
+
+  for (int i = 0; i < thread.buffer.size; ++i) {
+    auto const & record = thread.buffer.records[i];
+    auto & ed = getEventData(record.id);
+    Event::Clock::time_point const timestamp{Event::Clock::duration{record.timestamp}};
+    Event::Clock::duration const duration{record.duration};
+    int const parent = running.empty() ? 0 : running.back().node;
+
+    switch (record.transition) {
+    case Transition::Start:
+    case Transition::Resume: {
+      int const node = getChildNode(parent, record.id);
+      if (record.transition == Transition::Start)
+        tree.nodes[node].count++;
+      tree.nodes[node].transitions++;
+      ed.transitions++;
+      bool const traced = isTraced(ed, record.timestamp);
+      running.push_back({record.id, node, record.timestamp, traced});
+      if (traced) {
+        ed.stateChanges.emplace_back(Event::State::STARTED, timestamp);
+        ed.stateChangeThreads.push_back(thread.buffer.thread);
+      }
+      break;
+    }
+    case Transition::Pause:
+    case Transition::Stop: {
+      // Usually the innermost event is left, but events are not required to be properly nested
+      auto found = std::find_if(running.rbegin(), running.rend(),
+                                [&](RunningEvent const & e) { return e.id == record.id; });
+      bool traced = recordStateChanges and not ed.throttled;
+      if (found != running.rend()) {
+        Event::Clock::duration const run(record.timestamp - found->start);
+        tree.nodes[found->node].inclusive += run;
+        tree.nodes[found->node].transitions++;
+        traced = found->traced;
+        if (streaming) {
+          auto const initialized = localRankData.getInitializedAtTicks().time_since_epoch();
+          pendingRuns.push_back({names[record.id], thread.buffer.thread,
+                                 Event::Clock::duration(found->start) - initialized,
+                                 Event::Clock::duration(record.timestamp) - initialized,
+                                 record.transition == Transition::Stop});
+        }
+        // Remove the start of a short run, if nothing was recorded after it
+        if (traced and run < stateChangeThreshold and not ed.stateChanges.empty()
+            and ed.stateChanges.back().first == Event::State::STARTED
+            and ed.stateChanges.back().second.time_since_epoch().count() == found->start) {
+          ed.stateChanges.pop_back();
+          ed.stateChangeThreads.pop_back();
+          ed.untraced++;
+          traced = false;
+        }
+        running.erase(std::next(found).base());
+      }
+      ed.transitions++;
+      if (traced) {
+        ed.stateChanges.emplace_back(record.transition == Transition::Pause ? Event::State::PAUSED
+                                                                            : Event::State::STOPPED, timestamp);
+        ed.stateChangeThreads.push_back(thread.buffer.thread);
+      }
+      if (record.transition == Transition::Stop)
+        ed.put(duration);
+      break;
+    }
+    case Transition::StopPaused:
+      ed.transitions++;
+      // Only stops a paused event of the timeline, the run before the pause may be untraced
+      if (not ed.stateChanges.empty() and ed.stateChanges.back().first == Event::State::PAUSED
+          and ed.stateChangeThreads.back() == thread.buffer.thread) {
+        ed.stateChanges.emplace_back(Event::State::STOPPED, timestamp);
+        ed.stateChangeThreads.push_back(thread.buffer.thread);
+      }
+      ed.put(duration);
+      break;
+    case Transition::Given: {
+      int const node = getChildNode(parent, record.id);
+      tree.nodes[node].count++;
+      tree.nodes[node].inclusive += duration;
+      ed.put(duration);
+      break;
+    }
+    }
+  }
+  thread.buffer.size = 0;
+  mergeCalls(thread);
+}
+
+bool EventRegistry::isTraced(EventData & ed, Event::Clock::rep timestamp)
+{
+  if (ed.throttled) {
+    ed.untraced++;
+    return false;
+  }
+  if (not recordStateChanges)
+    return false;
+  // The rate is measured since initialize, so it needs some state changes to be meaningful
+  if (static_cast<long>(ed.stateChanges.size()) < throttleMinimum or globalEvent.state != Event::State::STARTED)
+    return true;
+
+  double const elapsed = std::chrono::duration<double>(
+    Event::Clock::duration(timestamp) - globalEvent.starttime.time_since_epoch()).count();
+  double const rate = ed.stateChanges.size() / elapsed;
+  double const overhead = ed.transitions * localRankData.transitionCost / 1e9 / elapsed;
+  if ((throttleRate > 0 and rate > throttleRate) or (throttleOverhead > 0 and overhead > throttleOverhead)) {
+    ed.throttled = true;
+    ed.untraced++;
+    return false;
+  }
+  return true;
+}
+
+EventData & EventRegistry::getEventData(int id)
+{
+  if (static_cast<size_t>(id) >= eventData.size())
+    eventData.resize(names.size(), nullptr);
+
+  if (eventData[id] == nullptr) {
+    /// Constructs or returns EventData object with name as key and name as arg to ctor.
+    auto data = std::get<0>(localRankData.evData.emplace(std::piecewise_construct,
+                                                         std::forward_as_tuple(names[id]),
+                                                         std::forward_as_tuple(names[id])));
+    eventData[id] = &data->second;
+  }
+  return *eventData[id];
+}
+
+void EventRegistry::calibrate()
+{
+  // Starts with an empty buffer, so the records of the calibration can be discarded
+  detail::Buffer * buffer = detail::overflow();
+  buffer->flushAt = std::numeric_limits<stdy_clk::rep>::max(); // initialize sets the deadline afterwards
+  Event event("_calibration", false, false);
+  event.recorded = true; // Measure the cost of recorded events, even if filtered
+
+  int const pairs = detail::Buffer::capacity / 2; // fills the buffer without flushing
+  double best = std::numeric_limits<double>::max();
+  for (int rep = 0; rep < 5; ++rep) {
+    buffer->size = 0;
+    auto const start = stdy_clk::now();
+    for (int i = 0; i < pairs; ++i) {
+      event.start();
+      event.stop();
+    }
+    std::chrono::duration<double, std::nano> const elapsed = stdy_clk::now() - start;
+    best = std::min(best, elapsed.count() / (2 * pairs));
+  }
+  buffer->size = 0;
+  localRankData.transitionCost = best;
+}
+
+int EventRegistry::getChildNode(int parent, int id)
+{
+  auto const key = (static_cast<unsigned long long>(parent) << 32) | static_cast<unsigned>(id);
+  auto found = childNodes.find(key);
+  if (found != childNodes.end())
+    return found->second;
+
+  int node = localRankData.callTree.child(parent, names[id]);
+  childNodes.emplace(key, node);
+  return node;
 }
 
 Event & EventRegistry::getStoredEvent(std::string const & name)
@@ -290,61 +1118,153 @@ void EventRegistry::printAll()
   int myRank;
   MPI_Comm_rank(comm, &myRank);
 
-  if (myRank != 0)
+  if (myRank != 0 or not enabled or not collectRanks)
     return;
 
-  std::string logFile;
-  if (applicationName.empty())
-    logFile = "Events.json";
-  else
-    logFile = applicationName + "-events.json";
+  createOutputDirectory();
+  addFormatSinks();
+  for (auto & sink : sinks)
+    sink->write(globalRankData);
+}
+
+
+void EventRegistry::addSink(std::unique_ptr<Sink> sink)
+{
+  Lock lock(mutex);
+  streaming = streaming or sink->isStreaming();
+  sinks.push_back(std::move(sink));
+}
+
+
+void EventRegistry::addFormatSinks()
+{
+  if (formatSinks)
+    return;
+  std::vector<std::unique_ptr<Sink>> added;
+  if (not collectRanks)
+    formats.insert("bin");
+  for (auto const & format : {"summary", "json", "folded", "comm", "counters", "csv", "trace", "bin"}) {
+    if (formats.count(format)) {
+      added.push_back(makeSink(format, getOutputBase()));
+      streaming = streaming or added.back()->isStreaming();
+    }
+  }
+  for (auto const & format : formats)
+    if (not makeSink(format, ""))
+      std::cerr << "EventTimings: Unknown format " << format << std::endl;
+
+  Lock lock(mutex);
+  sinks.insert(sinks.begin(), std::make_move_iterator(added.begin()), std::make_move_iterator(added.end()));
+  formatSinks = true;
+}
+
 
-  writeSummary(std::cout);
-  std::ofstream ofs(logFile);
-  writeJSON(ofs);
+void EventRegistry::createOutputDirectory() const
+{
+  // Fails harmlessly for existing directories
+  for (size_t slash = 1; slash != std::string::npos and not outputDirectory.empty(); ) {
+    slash = outputDirectory.find('/', slash);
+    mkdir(outputDirectory.substr(0, slash).c_str(), 0777);
+    if (slash != std::string::npos)
+      ++slash;
+  }
 }
 
 
-void EventRegistry::writeSummary(std::ostream &out)
+std::string EventRegistry::getOutputBase() const
 {
-  int rank, size;
+  std::string const name = applicationName.empty() ? "Events" : applicationName + "-events";
+  if (outputDirectory.empty())
+    return name;
+  return outputDirectory + "/" + name;
+}
+
+
+void EventRegistry::writeSummary(std::ostream & out)
+{
+  writeSummary(out, globalRankData);
+}
+
+void EventRegistry::writeSummary(std::ostream & out, std::vector<RankData> const & ranks)
+{
+  int rank;
   MPI_Comm_rank(comm, &rank);
-  MPI_Comm_size(comm, &size);
+
+  if (rank == 0 and ranks.empty()) { // Not collected, e.g., before finalize
+    writeSummary(out, {localRankData});
+    return;
+  }
 
   if (rank == 0) {
     using std::endl;
+    // The tables of a single rank show the first one, i.e., rank 0 of the data, that is not this rank, if it was read
+    auto const & first = ranks.front();
     { // Print per event stats
-      std::time_t ts = sys_clk::to_time_t(localRankData.finalizedAt);
-      double const duration = std::chrono::duration_cast<std::chrono::milliseconds>(localRankData.getDuration()).count();
+      std::time_t ts = sys_clk::to_time_t(first.finalizedAt);
+      double const duration = std::chrono::duration_cast<std::chrono::milliseconds>(first.getDuration()).count();
     
       out << "Run finished at " << std::asctime(std::localtime(&ts));
 
       out << "Global runtime       = "
           << duration << "ms / "
           << duration / 1000 << "s" << endl
-          << "Number of processors = " << size << endl
-          << "# Rank: " << rank << endl << endl;
+          << "Number of processors = " << ranks.size() << endl
+          << "Est. overhead        = " << first.getOverhead() << "ms, "
+          << first.transitionCost << "ns per start, pause or stop"
+          << (first.compensated ? ", subtracted from times" : "") << endl
+          << "# Rank: 0" << endl << endl;
 
       Table table(out);
-      table.addColumn("Event", getMaxNameWidth());
+      table.addColumn("Event", getMaxNameWidth(ranks));
       table.addColumn("Count", 10);
       table.addColumn("Total[ms]", 10);
       table.addColumn("Max[ms]", 10);
       table.addColumn("Min[ms]", 10);
       table.addColumn("Avg[ms]", 10);
       table.addColumn("Time Ratio", 6, 3);
+      table.addColumn("Overhead[ms]", 10, 3);
       table.printHeader();
     
-      for (auto & e : localRankData.evData) {
+      for (auto & e : first.evData) {
         auto & ev = e.second;
         table.printRow(ev.getName(), ev.getCount(), ev.getTotal(), ev.getMax(),  ev.getMin(), ev.getAvg(),
-                       divOrZero(ev.getTotal(), duration));
+                       divOrZero(ev.getTotal(), duration), ev.transitions * first.transitionCost / 1e6);
       }
     }
     out << endl << endl;
+    { // Print call tree
+      double const duration = std::chrono::duration_cast<std::chrono::milliseconds>(first.getDuration()).count();
+      auto const & tree = first.callTree;
+
+      size_t width = 0;
+      tree.traverse([&](int node, int depth) {
+          width = std::max(width, 2 * (depth - 1) + tree.nodes[node].name.size());
+        });
+
+      Table table(out);
+      table.addColumn("Call Path", width);
+      table.addColumn("Count", 10);
+      table.addColumn("Incl[ms]", 10);
+      table.addColumn("Excl[ms]", 10);
+      table.addColumn("Incl Ratio", 6, 3);
+      table.addColumn("Excl Ratio", 6, 3);
+      table.printHeader();
+
+      tree.traverse([&](int node, int depth) {
+          auto const & n = tree.nodes[node];
+          double const incl = std::chrono::duration_cast<std::chrono::milliseconds>(n.inclusive).count();
+          double const excl = std::chrono::duration_cast<std::chrono::milliseconds>(tree.getExclusive(node)).count();
+          // Table pads to the right, so indent by appending
+          std::string name = std::string(2 * (depth - 1), ' ') + n.name;
+          name.append(width - name.size(), ' ');
+          table.printRow(name, n.count, incl, excl, divOrZero(incl, duration), divOrZero(excl, duration));
+        });
+    }
+    auto const stats = getGlobalStats(ranks);
+    out << endl << endl;
     { // Print aggregated states
       Table t(out);
-      t.addColumn("Name", getMaxNameWidth());
+      t.addColumn("Name", getMaxNameWidth(ranks));
       t.addColumn("Max", 10);
       t.addColumn("MaxOnRank", 10);
       t.addColumn("Min", 10);
@@ -352,7 +1272,6 @@ void EventRegistry::writeSummary(std::ostream &out)
       t.addColumn("Min/Max", 10);
       t.printHeader();
 
-      auto stats = getGlobalStats(globalRankData);
       for (auto & e : stats) {
         auto & ev = e.second;
         double rel = 0;
@@ -362,11 +1281,707 @@ void EventRegistry::writeSummary(std::ostream &out)
         t.printRow(e.first, ev.max, ev.maxRank, ev.min, ev.minRank, rel);
       }
     }
+    writeCounters(out, stats);
+    writeCPUTimes(out, ranks, stats);
+    writeMPI(out, ranks, stats);
+    writeTraffic(out, ranks);
+    writeBarrierWaits(out, ranks);
+    writeSamples(out, stats);
+    writeMemory(out, stats);
+    writeIO(out, ranks, stats);
+    writeCounterSummary(out, ranks);
+    writeBudget(out, ranks);
+  }
+}
+
+
+void EventRegistry::writeCounters(std::ostream & out, std::map<std::string, GlobalEventStats> const & stats)
+{
+  std::string const group = "perf.";
+  std::set<std::string> counters;
+  for (auto const & e : stats)
+    for (auto const & metric : e.second.metrics)
+      if (metric.first.compare(0, group.size(), group) == 0)
+        counters.insert(metric.first);
+
+  if (counters.empty())
+    return;
+
+  // Rates are given per second of event time for counters of events that may stall
+  std::vector<std::string> rates;
+  for (auto const & counter : counters)
+    if (counter != "perf.cycles" and counter != "perf.instructions" and counter != "perf.task-clock")
+      rates.push_back(counter);
+  bool const hasIPC = counters.count("perf.cycles") and counters.count("perf.instructions");
+
+  out << std::endl << std::endl << "Performance counters, summed over all ranks" << std::endl;
+  Table table(out);
+  table.addColumn("Event", getMaxNameWidth(stats));
+  for (auto const & counter : counters)
+    table.addColumn(counter.substr(group.size()), 14);
+  if (hasIPC)
+    table.addColumn("IPC", 8, 3);
+  for (auto const & rate : rates)
+    table.addColumn(rate.substr(group.size()) + "/s", 14);
+  table.printHeader();
+
+  for (auto const & e : stats) {
+    auto const & metrics = e.second.metrics;
+    std::vector<double> row;
+    for (auto const & counter : counters)
+      row.push_back(metricOrZero(metrics, counter));
+    if (hasIPC)
+      row.push_back(divOrZero(metricOrZero(metrics, "perf.instructions"), metricOrZero(metrics, "perf.cycles")));
+    double const seconds = std::chrono::duration<double>(e.second.total).count();
+    for (auto const & rate : rates)
+      row.push_back(divOrZero(metricOrZero(metrics, rate), seconds));
+    table.printRowOf(e.first, row);
+  }
+}
+
+
+void EventRegistry::writeCPUTimes(std::ostream & out, std::vector<RankData> const & ranks,
+                                  std::map<std::string, GlobalEventStats> const & stats)
+{
+  bool hasCPUTime = false;
+  for (auto const & e : stats)
+    hasCPUTime = hasCPUTime or e.second.metrics.count("cpu.time");
+  if (not hasCPUTime)
+    return;
+
+  out << std::endl << std::endl << "CPU time, summed over all ranks" << std::endl;
+  Table table(out);
+  table.addColumn("Event", getMaxNameWidth(ranks));
+  table.addColumn("Wall[ms]", 10);
+  table.addColumn("CPU[ms]", 10);
+  table.addColumn("CPU/Wall", 8, 3);
+  table.addColumn("MinCPU/Wall", 8, 3);
+  table.addColumn("MinOnRank", 10);
+  table.addColumn("Voluntary CS", 12);
+  table.addColumn("Involuntary CS", 12);
+  table.printHeader();
+
+  for (auto const & e : stats) {
+    auto const & metrics = e.second.metrics;
+    double const wall = std::chrono::duration<double, std::milli>(e.second.total).count();
+    double const cpu = metricOrZero(metrics, "cpu.time") / 1e6;
+
+    // The rank, that spent the lowest share of the time on the CPU
+    double minRatio = std::numeric_limits<double>::max();
+    int minRank = 0;
+    for (size_t rank = 0; rank < ranks.size(); ++rank) {
+      auto ev = ranks[rank].evData.find(e.first);
+      if (ev == ranks[rank].evData.end() or ev->second.total == stdy_clk::duration::zero())
+        continue;
+      double const ratio = metricOrZero(ev->second.metrics, "cpu.time") / 1e6 /
+        std::chrono::duration<double, std::milli>(ev->second.total).count();
+      if (ratio < minRatio) {
+        minRatio = ratio;
+        minRank = rank;
+      }
+    }
+    if (minRatio == std::numeric_limits<double>::max())
+      minRatio = 0;
+
+    table.printRow(e.first, wall, cpu, divOrZero(cpu, wall), minRatio, minRank,
+                   metricOrZero(metrics, "cpu.voluntary-switches"), metricOrZero(metrics, "cpu.involuntary-switches"));
+  }
+}
+
+
+void EventRegistry::writeMPI(std::ostream & out, std::vector<RankData> const & ranks,
+                             std::map<std::string, GlobalEventStats> const & stats)
+{
+  bool hasMPI = false;
+  for (auto const & e : stats)
+    hasMPI = hasMPI or e.second.metrics.count("mpi.time");
+  if (not hasMPI)
+    return;
+
+  // MPI calls are attributed to the innermost event, so they are compared to the exclusive times
+  std::map<std::string, double> exclusive;
+  for (auto const & rank : ranks) {
+    auto const & tree = rank.callTree;
+    for (size_t node = 1; node < tree.nodes.size(); ++node)
+      exclusive[tree.nodes[node].name] +=
+        std::chrono::duration<double, std::milli>(tree.getExclusive(node)).count();
+  }
+
+  out << std::endl << std::endl << "Compute and MPI time, summed over all ranks" << std::endl;
+  {
+    Table table(out);
+    table.addColumn("Event", getMaxNameWidth(ranks));
+    table.addColumn("Excl[ms]", 10);
+    table.addColumn("Compute[ms]", 11);
+    table.addColumn("MPI[ms]", 10);
+    table.addColumn("MPI/Excl", 8, 3);
+    table.addColumn("MPI Calls", 10);
+    table.addColumn("MPI Bytes", 14);
+    table.printHeader();
+
+    for (auto const & e : stats) {
+      auto const & metrics = e.second.metrics;
+      double const excl = exclusive[e.first];
+      double const mpi = metricOrZero(metrics, "mpi.time") / 1e6;
+      table.printRow(e.first, excl, std::max(excl - mpi, 0.0), mpi, divOrZero(mpi, excl),
+                     metricOrZero(metrics, "mpi.calls"), metricOrZero(metrics, "mpi.bytes"));
+    }
+  }
+
+  out << std::endl << std::endl << "MPI calls, summed over all ranks" << std::endl;
+  {
+    // Per call metrics are named "mpi.<call>.calls"
+    std::string const group = "mpi.", suffix = ".calls";
+    std::map<std::string, std::vector<std::string>> calls; // event -> calls
+    size_t callWidth = 4;
+    for (auto const & e : stats) {
+      for (auto const & metric : e.second.metrics) {
+        auto const & name = metric.first;
+        if (name.size() > group.size() + suffix.size()
+            and name.compare(0, group.size(), group) == 0
+            and name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+          calls[e.first].push_back(name.substr(group.size(), name.size() - group.size() - suffix.size()));
+          callWidth = std::max(callWidth, calls[e.first].back().size());
+        }
+      }
+    }
+
+    Table table(out);
+    table.addColumn("Event", getMaxNameWidth(ranks));
+    table.addColumn("Call", callWidth);
+    table.addColumn("Calls", 10);
+    table.addColumn("Bytes", 14);
+    table.addColumn("Time[ms]", 10);
+    table.addColumn("Avg[us]", 10, 3);
+    table.printHeader();
+
+    for (auto const & e : calls) {
+      auto const & metrics = stats.at(e.first).metrics;
+      for (auto const & call : e.second) {
+        double const count = metricOrZero(metrics, group + call + ".calls");
+        double const time = metricOrZero(metrics, group + call + ".time") / 1e6;
+        table.printRow(e.first, call, count, metricOrZero(metrics, group + call + ".bytes"), time,
+                       divOrZero(time * 1e3, count));
+      }
+    }
+  }
+}
+
+
+void EventRegistry::writeTraffic(std::ostream & out, std::vector<RankData> const & ranks)
+{
+  /// Sum of the traffic of one event and its largest pair of ranks
+  struct Summary
+  {
+    Traffic total;
+    long pairs = 0;
+    Traffic max;
+    int maxSource = 0, maxTarget = 0;
+  };
+
+  std::map<std::string, Summary> summaries;
+  for (size_t rank = 0; rank < ranks.size(); ++rank) {
+    for (auto const & ev : ranks[rank].evData) {
+      for (auto const & peer : ev.second.sent) {
+        auto & summary = summaries[ev.first];
+        summary.total.bytes += peer.second.bytes;
+        summary.total.messages += peer.second.messages;
+        summary.pairs++;
+        if (peer.second.bytes > summary.max.bytes) {
+          summary.max = peer.second;
+          summary.maxSource = rank;
+          summary.maxTarget = peer.first;
+        }
+      }
+    }
+  }
+  if (summaries.empty())
+    return;
+
+  out << std::endl << std::endl << "Point-to-point traffic, summed over all ranks" << std::endl;
+  Table table(out);
+  table.addColumn("Event", getMaxNameWidth(ranks));
+  table.addColumn("Messages", 10);
+  table.addColumn("Bytes", 14);
+  table.addColumn("Pairs", 8);
+  table.addColumn("MaxPairBytes", 14);
+  table.addColumn("MaxSource", 10);
+  table.addColumn("MaxTarget", 10);
+  table.printHeader();
+
+  for (auto const & e : summaries) {
+    auto const & s = e.second;
+    table.printRow(e.first, s.total.messages, s.total.bytes, s.pairs, s.max.bytes, s.maxSource, s.maxTarget);
+  }
+}
+
+
+void EventRegistry::writeBarrierWaits(std::ostream & out, std::vector<RankData> const & ranks)
+{
+  /// Waits of one event over all ranks
+  struct Waits
+  {
+    double barriers = 0, total = 0, wait = 0, maxSingle = 0;
+    double max = -1, min = std::numeric_limits<double>::max();
+    int maxRank = 0, minRank = 0;
+  };
+
+  std::map<std::string, Waits> events;
+  for (size_t rank = 0; rank < ranks.size(); ++rank) {
+    for (auto const & ev : ranks[rank].evData) {
+      auto const & metrics = ev.second.metrics;
+      if (not metrics.count("barrier.count"))
+        continue;
+      auto & waits = events[ev.first];
+      double const wait = metricOrZero(metrics, "barrier.wait") / 1e6;
+      waits.barriers = std::max(waits.barriers, metricOrZero(metrics, "barrier.count"));
+      waits.total += std::chrono::duration<double, std::milli>(ev.second.total).count();
+      waits.wait += wait;
+      waits.maxSingle = std::max(waits.maxSingle, metricOrZero(metrics, "barrier.max-wait") / 1e6);
+      if (wait > waits.max) {
+        waits.max = wait;
+        waits.maxRank = rank;
+      }
+      if (wait < waits.min) {
+        waits.min = wait;
+        waits.minRank = rank;
+      }
+    }
+  }
+  if (events.empty())
+    return;
+
+  // The rank, that waited least, arrived last at the barriers, so it is the straggler
+  out << std::endl << std::endl << "Barrier wait, summed over all ranks" << std::endl;
+  Table table(out);
+  table.addColumn("Event", getMaxNameWidth(ranks));
+  table.addColumn("Barriers", 10);
+  table.addColumn("Wait[ms]", 10);
+  table.addColumn("Wait/Total", 8, 3);
+  table.addColumn("MaxWait[ms]", 11);
+  table.addColumn("MaxOnRank", 10);
+  table.addColumn("Straggler", 10);
+  table.addColumn("Imbalance[ms]", 13);
+  table.addColumn("MaxSingle[ms]", 13);
+  table.printHeader();
+
+  for (auto const & e : events) {
+    auto const & w = e.second;
+    table.printRow(e.first, w.barriers, w.wait, divOrZero(w.wait, w.total), w.max, w.maxRank,
+                   w.minRank, w.max - w.min, w.maxSingle);
+  }
+}
+
+
+void EventRegistry::writeSamples(std::ostream & out, std::map<std::string, GlobalEventStats> const & stats)
+{
+  double samples = 0;
+  for (auto const & e : stats)
+    samples += metricOrZero(e.second.metrics, "sample.self");
+  if (samples == 0)
+    return;
+
+  // _GLOBAL holds the samples outside of events, unless it was filtered
+  out << std::endl << std::endl << "Samples, summed over all ranks";
+  auto const global = stats.find("_GLOBAL");
+  if (global != stats.end())
+    out << ", " << metricOrZero(global->second.metrics, "sample.outside") << " outside of events, "
+        << metricOrZero(global->second.metrics, "sample.dropped") << " dropped";
+  out << std::endl;
+  {
+    Table table(out);
+    table.addColumn("Event", getMaxNameWidth(stats));
+    table.addColumn("Self", 10);
+    table.addColumn("Total", 10);
+    table.addColumn("Self Ratio", 6, 3);
+    table.addColumn("Total Ratio", 6, 3);
+    table.printHeader();
+
+    for (auto const & e : stats) {
+      auto const & metrics = e.second.metrics;
+      if (not metrics.count("sample.total"))
+        continue;
+      double const self = metricOrZero(metrics, "sample.self"), total = metricOrZero(metrics, "sample.total");
+      table.printRow(e.first, self, total, self / samples, total / samples);
+    }
+  }
+
+  // The functions with the most samples per event
+  int const maxHotspots = 5;
+  std::string const group = "hotspot.";
+  std::vector<std::tuple<std::string, std::string, double, double>> rows; // event, function, samples, ratio
+  size_t width = 8;
+  for (auto const & e : stats) {
+    auto const & metrics = e.second.metrics;
+    std::vector<std::pair<double, std::string>> hotspots;
+    for (auto it = metrics.lower_bound(group);
+         it != metrics.end() and it->first.compare(0, group.size(), group) == 0; ++it)
+      hotspots.emplace_back(it->second, it->first.substr(group.size()));
+    std::sort(hotspots.rbegin(), hotspots.rend());
+    if (hotspots.size() > maxHotspots)
+      hotspots.resize(maxHotspots);
+    for (auto const & hotspot : hotspots) {
+      rows.emplace_back(e.first, hotspot.second, hotspot.first,
+                        divOrZero(hotspot.first, metricOrZero(metrics, "sample.self")));
+      width = std::max(width, hotspot.second.size());
+    }
+  }
+  if (rows.empty())
+    return;
+
+  out << std::endl << std::endl << "Hotspots, summed over all ranks" << std::endl;
+  Table table(out);
+  table.addColumn("Event", getMaxNameWidth(stats));
+  table.addColumn("Function", width);
+  table.addColumn("Samples", 10);
+  table.addColumn("Self Ratio", 6, 3);
+  table.printHeader();
+  for (auto const & row : rows) {
+    // Table pads to the right, so pad the function names to the left
+    auto function = std::get<1>(row);
+    function.append(width - function.size(), ' ');
+    table.printRow(std::get<0>(row), function, std::get<2>(row), std::get<3>(row));
+  }
+}
+
+
+void EventRegistry::writeMemory(std::ostream & out, std::map<std::string, GlobalEventStats> const & stats)
+{
+  std::string const group = "memory.";
+  bool hasMemory = false;
+  for (auto const & e : stats) {
+    auto next = e.second.metrics.lower_bound(group);
+    hasMemory = hasMemory or (next != e.second.metrics.end() and next->first.compare(0, group.size(), group) == 0);
+  }
+  if (not hasMemory)
+    return;
+
+  double const MB = 1024 * 1024;
+  out << std::endl << std::endl << "Memory, summed over all ranks" << std::endl;
+  Table table(out);
+  table.addColumn("Event", getMaxNameWidth(stats));
+  table.addColumn("Allocs", 10);
+  table.addColumn("Frees", 10);
+  table.addColumn("Allocated[MB]", 13);
+  table.addColumn("Freed[MB]", 10);
+  table.addColumn("Net[MB]", 10);
+  table.addColumn("Allocs/s", 12);
+  table.addColumn("RSS Growth[MB]", 14);
+  table.addColumn("Peak Growth[MB]", 15);
+  table.printHeader();
+
+  for (auto const & e : stats) {
+    auto const & metrics = e.second.metrics;
+    double const allocated = metricOrZero(metrics, "memory.allocated") / MB, freed = metricOrZero(metrics, "memory.freed") / MB;
+    double const seconds = std::chrono::duration<double>(e.second.total).count();
+    table.printRow(e.first, metricOrZero(metrics, "memory.allocations"), metricOrZero(metrics, "memory.frees"),
+                   allocated, freed, allocated - freed,
+                   divOrZero(metricOrZero(metrics, "memory.allocations"), seconds),
+                   metricOrZero(metrics, "memory.rss") / MB, metricOrZero(metrics, "memory.peak-rss") / MB);
+  }
+}
+
+
+void EventRegistry::writeIO(std::ostream & out, std::vector<RankData> const & ranks,
+                            std::map<std::string, GlobalEventStats> const & stats)
+{
+  bool hasIO = false;
+  for (auto const & e : stats)
+    hasIO = hasIO or e.second.metrics.count("io.time");
+  if (not hasIO)
+    return;
+
+  double const MB = 1024 * 1024;
+  out << std::endl << std::endl << "I/O, summed over all ranks" << std::endl;
+  Table table(out);
+  table.addColumn("Event", getMaxNameWidth(ranks));
+  table.addColumn("Calls", 10);
+  table.addColumn("Read[MB]", 10);
+  table.addColumn("Written[MB]", 11);
+  table.addColumn("Time[ms]", 10);
+  table.addColumn("MB/s", 10);
+  table.addColumn("I/O Ratio", 6, 3);
+  table.addColumn("Max I/O Ratio", 6, 3);
+  table.addColumn("MaxOnRank", 10);
+  table.printHeader();
+
+  for (auto const & e : stats) {
+    auto const & metrics = e.second.metrics;
+    if (not metrics.count("io.time"))
+      continue;
+    double read = 0, written = 0;
+    for (auto const & metric : metrics) {
+      auto const & name = metric.first;
+      if (name.compare(0, 3, "io.") != 0 or name.size() < 6 or name.compare(name.size() - 6, 6, ".bytes") != 0)
+        continue;
+      if (name.find("read") != std::string::npos)
+        read += metric.second;
+      else if (name.find("write") != std::string::npos)
+        written += metric.second;
+    }
+    double const time = metricOrZero(metrics, "io.time") / 1e6;
+    double const total = std::chrono::duration<double, std::milli>(e.second.total).count();
+
+    // The rank, that spent the largest share of the event in I/O
+    double maxRatio = 0;
+    int maxRank = 0;
+    for (size_t rank = 0; rank < ranks.size(); ++rank) {
+      auto ev = ranks[rank].evData.find(e.first);
+      if (ev == ranks[rank].evData.end() or ev->second.total == stdy_clk::duration::zero())
+        continue;
+      double const ratio = metricOrZero(ev->second.metrics, "io.time") / 1e6 /
+        std::chrono::duration<double, std::milli>(ev->second.total).count();
+      if (ratio > maxRatio) {
+        maxRatio = ratio;
+        maxRank = rank;
+      }
+    }
+
+    table.printRow(e.first, metricOrZero(metrics, "io.calls"), read / MB, written / MB, time,
+                   divOrZero((read + written) / MB, time / 1e3), divOrZero(time, total), maxRatio, maxRank);
+  }
+}
+
+
+void EventRegistry::writeBudget(std::ostream & out, std::vector<RankData> const & ranks)
+{
+  size_t decisions = 0, width = 7;
+  for (auto const & rank : ranks) {
+    decisions += rank.decisions.size();
+    for (auto const & d : rank.decisions)
+      width = std::max(width, d.subject.size());
+  }
+  if (decisions == 0)
+    return;
+
+  size_t const maxRows = 50;
+  out << std::endl << std::endl << "Overhead budget of " << overheadBudget * 100 << "% of the runtime, decisions";
+  if (decisions > maxRows)
+    out << ", first " << maxRows << " of " << decisions;
+  out << std::endl;
+  Table table(out);
+  table.addColumn("Rank", 6);
+  table.addColumn("Time[s]", 10);
+  table.addColumn("Overhead", 8, 3);
+  table.addColumn("Action", 15);
+  table.addColumn("Subject", width);
+  table.printHeader();
+
+  size_t rows = 0;
+  for (size_t rank = 0; rank < ranks.size(); ++rank)
+    for (auto const & d : ranks[rank].decisions)
+      if (rows++ < maxRows)
+        table.printRow(static_cast<int>(rank), d.time, d.overhead, d.action, d.subject);
+}
+
+
+void EventRegistry::writeCounterSummary(std::ostream & out, std::vector<RankData> const & ranks)
+{
+  /// Samples of one counter over all ranks
+  struct Summary
+  {
+    long samples = 0;
+    double sum = 0, min = std::numeric_limits<double>::max(), max = std::numeric_limits<double>::lowest();
+    int minRank = 0, maxRank = 0;
+  };
+
+  std::map<std::string, Summary> counters;
+  size_t width = 7;
+  for (size_t rank = 0; rank < ranks.size(); ++rank) {
+    for (auto const & c : ranks[rank].counters) {
+      auto & summary = counters[c.first];
+      width = std::max(width, c.first.size());
+      for (double value : c.second.values) {
+        summary.samples++;
+        summary.sum += value;
+        if (value < summary.min) {
+          summary.min = value;
+          summary.minRank = rank;
+        }
+        if (value > summary.max) {
+          summary.max = value;
+          summary.maxRank = rank;
+        }
+      }
+    }
+  }
+  if (counters.empty())
+    return;
+
+  out << std::endl << std::endl << "Counters, over all ranks" << std::endl;
+  Table table(out);
+  table.addColumn("Counter", width);
+  table.addColumn("Samples", 10);
+  table.addColumn("Min", 12);
+  table.addColumn("MinOnRank", 10);
+  table.addColumn("Mean", 12);
+  table.addColumn("Max", 12);
+  table.addColumn("MaxOnRank", 10);
+  table.printHeader();
+
+  for (auto const & c : counters) {
+    auto const & s = c.second;
+    if (s.samples == 0)
+      continue;
+    table.printRow(c.first, s.samples, s.min, s.minRank, s.sum / s.samples, s.max, s.maxRank);
+  }
+}
+
+
+void EventRegistry::writeCommunication(std::ostream & out)
+{
+  writeCommunication(out, globalRankData);
+}
+
+void EventRegistry::writeCommunication(std::ostream & out, std::vector<RankData> const & ranks)
+{
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  if (rank != 0)
+    return;
+
+  // Sorted by event, then by source and target
+  std::map<std::string, std::vector<std::pair<int, EventData const *>>> events;
+  for (size_t source = 0; source < ranks.size(); ++source)
+    for (auto const & ev : ranks[source].evData)
+      if (not ev.second.sent.empty())
+        events[ev.first].emplace_back(source, &ev.second);
+
+  out << "# Ranks " << ranks.size() << "\n"
+      << "# Event\tSource\tTarget\tBytes\tMessages\n";
+  for (auto const & e : events)
+    for (auto const & row : e.second)
+      for (auto const & peer : row.second->sent)
+        out << e.first << '\t' << row.first << '\t' << peer.first << '\t'
+            << peer.second.bytes << '\t' << peer.second.messages << '\n';
+}
+
+
+/// Writes the bytes of a trivially copyable value
+template<typename T> void writeBinary(std::ostream & out, T const & value)
+{
+  out.write(reinterpret_cast<char const *>(&value), sizeof(T));
+}
+
+
+void EventRegistry::writeCounterSeries(std::ostream & out)
+{
+  writeCounterSeries(out, globalRankData);
+}
+
+void EventRegistry::writeCounterSeries(std::ostream & out, std::vector<RankData> const & ranks)
+{
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  if (rank != 0)
+    return;
+
+  std::uint32_t series = 0;
+  for (auto const & rankData : ranks)
+    series += rankData.counters.size();
+
+  out.write("ETSERIES", 8);
+  writeBinary<std::uint32_t>(out, 1); // Version
+  writeBinary(out, series);
+  for (size_t r = 0; r < ranks.size(); ++r) {
+    for (auto const & c : ranks[r].counters) {
+      auto const & timestamps = c.second.timestamps;
+      auto const & values = c.second.values;
+      writeBinary<std::int32_t>(out, r);
+      writeBinary<std::uint32_t>(out, c.first.size());
+      out.write(c.first.data(), c.first.size());
+      writeBinary<std::uint64_t>(out, values.size());
+      static_assert(sizeof(timestamps[0]) == sizeof(std::int64_t) and std::is_same<stdy_clk::period, std::nano>::value,
+                    "Timestamps are written as 64 bit integers of nanoseconds");
+      out.write(reinterpret_cast<char const *>(timestamps.data()), timestamps.size() * sizeof(timestamps[0]));
+      out.write(reinterpret_cast<char const *>(values.data()), values.size() * sizeof(double));
+    }
+  }
+  out.flush();
+}
+
+
+/// Converts the aggregated timings of the events of a rank to JSON
+nlohmann::json timingsToJSON(RankData const & rank)
+{
+  using namespace std::chrono;
+  auto jTimings = nlohmann::json::object();
+  double const duration = duration_cast<milliseconds>(rank.getDuration()).count();
+  for (auto const & events : rank.evData) {
+    auto const & e = events.second;
+    jTimings[e.getName()] = {
+      {"Count", e.getCount()},
+      {"Total", e.getTotal()},
+      {"Max", e.getMax()},
+      {"Min", e.getMin()},
+      {"TimeRatio", divOrZero(e.getTotal(), duration)},
+      {"Transitions", e.transitions},
+      {"Overhead", e.transitions * rank.transitionCost / 1e6},
+      {"Throttled", e.throttled},
+      {"Untraced", e.untraced},
+      {"Metrics", e.metrics},
+      {"Data" , e.getData()}
+    };
+  }
+  return jTimings;
+}
+
+
+/// Converts the call paths below the root of a call tree to JSON
+nlohmann::json callTreeToJSON(CallTree const & tree)
+{
+  using json = nlohmann::json;
+  using namespace std::chrono;
+  std::function<json(int)> nodeToJSON = [&](int node) {
+    auto jChildren = json::array();
+    for (int c : tree.getChildren(node))
+      jChildren.push_back(nodeToJSON(c));
+    return json{
+      {"Name", tree.nodes[node].name},
+      {"Count", tree.nodes[node].count},
+      {"Inclusive", duration_cast<milliseconds>(tree.nodes[node].inclusive).count()},
+      {"Exclusive", duration_cast<milliseconds>(tree.getExclusive(node)).count()},
+      {"Children", jChildren}
+    };
+  };
+  auto jCallTree = json::array();
+  for (int c : tree.getChildren(0))
+    jCallTree.push_back(nodeToJSON(c));
+  return jCallTree;
+}
+
+
+void EventRegistry::writeSnapshot()
+{
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  lastSnapshot = Event::Clock::now();
+
+  nlohmann::json js = {
+    {"Name", runName},
+    {"Rank", rank},
+    {"Initialized", timepoint_to_string(localRankData.initializedAt)},
+    {"Written", timepoint_to_string(sys_clk::now())},
+    {"Timings", timingsToJSON(localRankData)},
+    {"CallTree", callTreeToJSON(localRankData.callTree)}
+  };
+
+  // Replace the previous snapshot atomically, so readers never see a partial file
+  std::string const file = getOutputBase() + ".rank" + std::to_string(rank) + ".snapshot.json";
+  {
+    std::ofstream out(file + ".tmp");
+    out << std::setw(2) << js << std::endl;
   }
+  std::rename((file + ".tmp").c_str(), file.c_str());
 }
 
 
 void EventRegistry::writeJSON(std::ostream & out)
+{
+  writeJSON(out, globalRankData);
+}
+
+void EventRegistry::writeJSON(std::ostream & out, std::vector<RankData> const & ranks)
 {
   using json = nlohmann::json;
   using namespace std::chrono;
@@ -374,38 +1989,52 @@ void EventRegistry::writeJSON(std::ostream & out)
   json js;
 
   sys_clk::time_point initT, finalT;
-  std::tie(initT, finalT) = findFirstAndLastTime();
+  std::tie(initT, finalT) = findFirstAndLastTime(ranks);
   js["Name"] = runName;
   js["Initialized"] = timepoint_to_string(initT);
   js["Finalized"] = timepoint_to_string(finalT);
 
-  for (auto const & rank : globalRankData) {
-    auto jTimings = json::object();
+  for (auto const & rank : ranks) {
+    // Sorted by time, so converters can process them in one pass
     auto jStateChanges = json::array();
-    double const duration = duration_cast<milliseconds>(rank.getDuration()).count();
-    for (auto const & events : rank.evData) {
-      auto const & e = events.second;
-      jTimings[events.second.getName()] = {
-        {"Count", e.getCount()},
-        {"Total", e.getTotal()},
-        {"Max", e.getMax()},
-        {"Min", e.getMin()},
-        {"TimeRatio", divOrZero(e.getTotal(), duration)},
-        {"Data" , e.getData()}
+    for (auto const & sc : rank.timeline()) {
+      jStateChanges.push_back({
+          {"Name", sc.event->getName()},
+          {"State", sc.state},
+          {"Timestamp", duration_cast<milliseconds>(sc.time.time_since_epoch()).count()}
+        });
+    }
+    auto jDecisions = json::array();
+    for (auto const & d : rank.decisions)
+      jDecisions.push_back({
+          {"Time", d.time},
+          {"Overhead", d.overhead},
+          {"Action", d.action},
+          {"Subject", d.subject}
+        });
+
+    auto jCounters = json::object();
+    for (auto const & c : rank.counters) {
+      auto jTimestamps = json::array();
+      for (auto ts : c.second.timestamps)
+        jTimestamps.push_back(std::chrono::duration<double, std::milli>(stdy_clk::duration(ts)).count());
+      jCounters[c.first] = {
+        {"Timestamps", jTimestamps},
+        {"Values", c.second.values}
       };
-      for (auto const & sc : e.stateChanges) {
-        jStateChanges.push_back({
-            {"Name", events.second.getName()},
-            {"State", sc.first},
-            {"Timestamp", duration_cast<milliseconds>(sc.second.time_since_epoch()).count()}
-          });
-      }
     }
+
     js["Ranks"].push_back({
         {"Finalized", timepoint_to_string(rank.finalizedAt)},
         {"Initialized", timepoint_to_string(rank.initializedAt)},
-        {"Timings", jTimings},
-        {"StateChanges", jStateChanges}
+        {"Timings", timingsToJSON(rank)},
+        {"StateChanges", jStateChanges},
+        {"CallTree", callTreeToJSON(rank.callTree)},
+        {"Counters", jCounters},
+        {"BudgetDecisions", jDecisions},
+        {"TransitionCost", rank.transitionCost},
+        {"Overhead", rank.getOverhead()},
+        {"Compensated", rank.compensated}
       });
   }
   
@@ -413,6 +2042,32 @@ void EventRegistry::writeJSON(std::ostream & out)
 }
 
 
+void EventRegistry::writeFolded(std::ostream & out, bool merged)
+{
+  writeFolded(out, globalRankData, merged);
+}
+
+void EventRegistry::writeFolded(std::ostream & out, std::vector<RankData> const & ranks, bool merged)
+{
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  if (rank != 0)
+    return;
+
+  if (merged) {
+    CallTree tree;
+    for (auto const & rankData : ranks)
+      tree.merge(rankData.callTree);
+    tree.writeFolded(out);
+  }
+  else {
+    for (size_t r = 0; r < ranks.size(); ++r)
+      ranks[r].callTree.writeFolded(out, "rank " + std::to_string(r));
+  }
+  out.flush();
+}
+
+
 MPI_Comm const & EventRegistry::getMPIComm() const
 {
   return comm;
@@ -423,13 +2078,21 @@ void EventRegistry::collect()
 {
   // Register MPI datatype
   MPI_Datatype MPI_EVENTDATA;
-  int blocklengths[] = {255, 1, 3, 2};
+  int blocklengths[] = {255, 1, 5, 5};
   MPI_Aint displacements[] = {offsetof(MPI_EventData, name), offsetof(MPI_EventData, count),
                               offsetof(MPI_EventData, total), offsetof(MPI_EventData, dataSize)};
   MPI_Datatype types[] = {MPI_CHAR, MPI_INT, MPI_LONG, MPI_INT};
   MPI_Type_create_struct(4, blocklengths, displacements, types, &MPI_EVENTDATA);
   MPI_Type_commit(&MPI_EVENTDATA);
 
+  MPI_Datatype MPI_CALLNODE;
+  int nodeBlocklengths[] = {255, 1, 3};
+  MPI_Aint nodeDisplacements[] = {offsetof(MPI_CallNode, name), offsetof(MPI_CallNode, parent),
+                                  offsetof(MPI_CallNode, count)};
+  MPI_Datatype nodeTypes[] = {MPI_CHAR, MPI_INT, MPI_LONG};
+  MPI_Type_create_struct(3, nodeBlocklengths, nodeDisplacements, nodeTypes, &MPI_CALLNODE);
+  MPI_Type_commit(&MPI_CALLNODE);
+
   int rank, MPIsize;
   MPI_Comm_rank(comm, &rank);
   MPI_Comm_size(comm, &MPIsize);
@@ -441,6 +2104,7 @@ void EventRegistry::collect()
 
   std::vector<MPI_EventData> eventSendBuf(eventsSize);
   std::vector<std::vector<long>> stateChangesBuf(eventsSize);
+  std::vector<std::vector<long>> sentBuf(eventsSize);
   int i = 0;
 
   MPI_Request req;
@@ -451,6 +2115,26 @@ void EventRegistry::collect()
   MPI_Isend(&times, times.size(), MPI_LONG, 0, 0, comm, &req);
   requests.push_back(req);  
 
+  // Send the estimated cost of the instrumentation
+  std::array<double, 2> overhead = {localRankData.transitionCost,
+                                    static_cast<double>(localRankData.compensated)};
+  MPI_Isend(&overhead, overhead.size(), MPI_DOUBLE, 0, 0, comm, &req);
+  requests.push_back(req);
+
+  // Send the metrics of all events at once, in the order of the events, as names terminated by '\0' and values
+  std::string metricNames;
+  std::vector<double> metricValues;
+  for (auto const & evData : localRankData.evData)
+    for (auto const & metric : evData.second.metrics) {
+      metricNames += metric.first;
+      metricNames += '\0';
+      metricValues.push_back(metric.second);
+    }
+  MPI_Isend(metricNames.c_str(), metricNames.size(), MPI_CHAR, 0, 0, comm, &req);
+  requests.push_back(req);
+  MPI_Isend(metricValues.data(), metricValues.size(), MPI_DOUBLE, 0, 0, comm, &req);
+  requests.push_back(req);
+
   // Send all events from all ranks, including rank 0, to rank 0
   for (auto const & evData : localRankData.evData) {
     const auto & ev = evData.second;
@@ -463,8 +2147,13 @@ void EventRegistry::collect()
     eventSendBuf[i].total = ev.getTotal();
     eventSendBuf[i].max = ev.getMax();
     eventSendBuf[i].min = ev.getMin();
+    eventSendBuf[i].transitions = ev.transitions;
+    eventSendBuf[i].untraced = ev.untraced;
+    eventSendBuf[i].throttled = ev.throttled;
     eventSendBuf[i].dataSize = ev.getData().size();
     eventSendBuf[i].stateChangesSize = ev.stateChanges.size();
+    eventSendBuf[i].metricsSize = ev.metrics.size();
+    eventSendBuf[i].sentSize = ev.sent.size();
     MPI_Isend(&eventSendBuf[i], 1, MPI_EVENTDATA, 0, 0, comm, &req);
     requests.push_back(req);
     
@@ -486,10 +2175,67 @@ void EventRegistry::collect()
       MPI_Isend(val.data(), val.size(), MPI_INT, 0, 0, comm, &req);
       requests.push_back(req);
     }
+
+    // Send the row of the communication matrix as (peer, bytes, messages) triplets
+    for (auto const & peer : ev.sent) {
+      sentBuf[i].push_back(peer.first);
+      sentBuf[i].push_back(peer.second.bytes);
+      sentBuf[i].push_back(peer.second.messages);
+    }
+    MPI_Isend(sentBuf[i].data(), sentBuf[i].size(), MPI_LONG, 0, 0, comm, &req);
+    requests.push_back(req);
     
     ++i;
   }
 
+  // Send the call tree, except the root
+  auto const & tree = localRankData.callTree;
+  std::vector<MPI_CallNode> nodesSendBuf(tree.nodes.size() - 1);
+  for (size_t n = 1; n < tree.nodes.size(); ++n) {
+    auto & node = nodesSendBuf[n - 1];
+    assert(tree.nodes[n].name.size() <= sizeof(node.name));
+    tree.nodes[n].name.copy(node.name, sizeof(node.name));
+    node.parent = tree.nodes[n].parent;
+    node.count = tree.nodes[n].count;
+    node.inclusive = tree.nodes[n].inclusive.count();
+    node.transitions = tree.nodes[n].transitions;
+  }
+  int nodesSize = nodesSendBuf.size();
+  MPI_Isend(&nodesSize, 1, MPI_INT, 0, 0, comm, &req);
+  requests.push_back(req);
+  MPI_Isend(nodesSendBuf.data(), nodesSize, MPI_CALLNODE, 0, 0, comm, &req);
+  requests.push_back(req);
+
+  // Send the decisions of the overhead budget controller as "<action>\t<subject>" and (time, overhead)
+  int decisionsSize = localRankData.decisions.size();
+  std::vector<std::string> decisionsBuf;
+  std::vector<std::array<double, 2>> decisionsValues;
+  for (auto const & d : localRankData.decisions) {
+    decisionsBuf.push_back(d.action + '\t' + d.subject);
+    decisionsValues.push_back({d.time, d.overhead});
+  }
+  MPI_Isend(&decisionsSize, 1, MPI_INT, 0, 0, comm, &req);
+  requests.push_back(req);
+  for (int d = 0; d < decisionsSize; ++d) {
+    MPI_Isend(decisionsBuf[d].c_str(), decisionsBuf[d].size(), MPI_CHAR, 0, 0, comm, &req);
+    requests.push_back(req);
+    MPI_Isend(decisionsValues[d].data(), 2, MPI_DOUBLE, 0, 0, comm, &req);
+    requests.push_back(req);
+  }
+
+  // Send the time series of the counters
+  int countersSize = localRankData.counters.size();
+  MPI_Isend(&countersSize, 1, MPI_INT, 0, 0, comm, &req);
+  requests.push_back(req);
+  for (auto const & c : localRankData.counters) {
+    MPI_Isend(c.first.c_str(), c.first.size(), MPI_CHAR, 0, 0, comm, &req);
+    requests.push_back(req);
+    MPI_Isend(c.second.timestamps.data(), c.second.timestamps.size(), MPI_LONG, 0, 0, comm, &req);
+    requests.push_back(req);
+    MPI_Isend(c.second.values.data(), c.second.values.size(), MPI_DOUBLE, 0, 0, comm, &req);
+    requests.push_back(req);
+  }
+
   // Receive
   if (rank == 0) {
     for (int i = 0; i < MPIsize; ++i) {
@@ -500,6 +2246,22 @@ void EventRegistry::collect()
       data.initializedAt = sys_clk::time_point(sys_clk::duration(recvTimes[0]));
       data.finalizedAt = sys_clk::time_point(sys_clk::duration(recvTimes[1]));
 
+      std::array<double, 2> recvOverhead;
+      MPI_Recv(&recvOverhead, 2, MPI_DOUBLE, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
+      data.transitionCost = recvOverhead[0];
+      data.compensated = recvOverhead[1] != 0;
+
+      // Receive the metrics of all events, they are split by the number of metrics of each event
+      MPI_Status metricsStatus;
+      int metricsCount = 0;
+      MPI_Probe(i, MPI_ANY_TAG, comm, &metricsStatus);
+      MPI_Get_count(&metricsStatus, MPI_CHAR, &metricsCount);
+      std::string recvMetricNames(metricsCount, '\0');
+      MPI_Recv(&recvMetricNames[0], metricsCount, MPI_CHAR, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
+      std::vector<double> recvMetricValues(std::count(recvMetricNames.begin(), recvMetricNames.end(), '\0'));
+      MPI_Recv(recvMetricValues.data(), recvMetricValues.size(), MPI_DOUBLE, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
+      size_t metricName = 0, metricValue = 0;
+
       // Receive all events from this rank
       for (int j = 0; j < eventsPerRank[i]; ++j) {
         // Receive aggregated EventData
@@ -532,27 +2294,127 @@ void EventRegistry::collect()
           dataMap[key] = val;
         }
 
+        // Take the metrics of this event
+        std::map<std::string, double> metrics;
+        for (int j = 0; j < ev.metricsSize; j++) {
+          auto const end = recvMetricNames.find('\0', metricName);
+          metrics[recvMetricNames.substr(metricName, end - metricName)] = recvMetricValues[metricValue++];
+          metricName = end + 1;
+        }
+
+        // Receive the row of the communication matrix
+        std::vector<long> recvSent(ev.sentSize * 3);
+        MPI_Recv(recvSent.data(), recvSent.size(), MPI_LONG, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
+
         // Create the EventData
         EventData ed(ev.name, ev.count, ev.total, ev.max, ev.min, dataMap, stateChanges);
+        ed.transitions = ev.transitions;
+        ed.untraced = ev.untraced;
+        ed.throttled = ev.throttled;
+        ed.metrics = std::move(metrics);
+        for (size_t k = 0; k < recvSent.size(); k += 3) {
+          auto & traffic = ed.sent[recvSent[k]];
+          traffic.bytes = recvSent[k + 1];
+          traffic.messages = recvSent[k + 2];
+        }
         data.addEventData(std::move(ed));
       }
+
+      // Receive the call tree, parents are always sent before their children
+      int recvNodesSize;
+      MPI_Recv(&recvNodesSize, 1, MPI_INT, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
+      std::vector<MPI_CallNode> recvNodes(recvNodesSize);
+      MPI_Recv(recvNodes.data(), recvNodesSize, MPI_CALLNODE, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
+      for (auto const & recvNode : recvNodes) {
+        auto & node = data.callTree.nodes[data.callTree.child(recvNode.parent, recvNode.name)];
+        node.count = recvNode.count;
+        node.inclusive = Event::Clock::duration(recvNode.inclusive);
+        node.transitions = recvNode.transitions;
+      }
+
+      // Receive the decisions of the overhead budget controller
+      int recvDecisionsSize;
+      MPI_Recv(&recvDecisionsSize, 1, MPI_INT, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
+      for (int j = 0; j < recvDecisionsSize; ++j) {
+        MPI_Status status;
+        int count = 0;
+        MPI_Probe(i, MPI_ANY_TAG, comm, &status);
+        MPI_Get_count(&status, MPI_CHAR, &count);
+        std::string text(count, '\0');
+        MPI_Recv(&text[0], count, MPI_CHAR, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
+        std::array<double, 2> values;
+        MPI_Recv(values.data(), 2, MPI_DOUBLE, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
+        auto const tab = text.find('\t');
+        data.decisions.push_back({values[0], values[1], text.substr(0, tab), text.substr(tab + 1)});
+      }
+
+      // Receive the time series of the counters
+      int recvCountersSize;
+      MPI_Recv(&recvCountersSize, 1, MPI_INT, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
+      for (int j = 0; j < recvCountersSize; ++j) {
+        MPI_Status status;
+        int count = 0;
+        MPI_Probe(i, MPI_ANY_TAG, comm, &status);
+        MPI_Get_count(&status, MPI_CHAR, &count);
+        std::string name(count, '\0');
+        MPI_Recv(&name[0], count, MPI_CHAR, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
+        auto & series = data.counters[name];
+        MPI_Probe(i, MPI_ANY_TAG, comm, &status);
+        MPI_Get_count(&status, MPI_LONG, &count);
+        series.timestamps.resize(count);
+        MPI_Recv(series.timestamps.data(), count, MPI_LONG, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
+        series.values.resize(count);
+        MPI_Recv(series.values.data(), count, MPI_DOUBLE, i, MPI_ANY_TAG, comm, MPI_STATUS_IGNORE);
+      }
       globalRankData.push_back(data);      
     }
   }
   MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
   MPI_Type_free(&MPI_EVENTDATA);
+  MPI_Type_free(&MPI_CALLNODE);
 }
 
 
-void EventRegistry::normalize()
+sys_clk::time_point EventRegistry::findFirstInitialized()
 {
   long ticks = localRankData.initializedAt.time_since_epoch().count();
   long minTicks;
   MPI_Allreduce(&ticks, &minTicks, 1, MPI_LONG, MPI_MIN, EventRegistry::instance().getMPIComm());
 
   // This assumes the same epoch and ticks rep, should be true for system time
-  sys_clk::time_point t0{sys_clk::duration{minTicks}};
-  localRankData.normalizeTo(t0);
+  return sys_clk::time_point{sys_clk::duration{minTicks}};
+}
+
+bool EventRegistry::setGlobalRankData(std::vector<RankData> ranks, std::vector<bool> const & found, unsigned threads)
+{
+  if (ranks.empty())
+    return false;
+
+  // Ranks not found have no events and the times of the first rank found
+  auto const first = std::find(found.begin(), found.end(), true) - found.begin();
+  auto t0 = ranks[first].initializedAt;
+  for (size_t rank = 0; rank < ranks.size(); ++rank) {
+    if (found[rank])
+      t0 = std::min(t0, ranks[rank].initializedAt);
+    else {
+      std::cerr << "EventTimings: Missing the data of rank " << rank << std::endl;
+      ranks[rank].initialize(ranks[first].initializedAt, ranks[first].getInitializedAtTicks());
+      ranks[rank].finalize(ranks[first].finalizedAt, ranks[first].getInitializedAtTicks());
+    }
+  }
+
+  // Normalize to the rank initialized first, as finalize does
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; ++t)
+    workers.emplace_back([&, t]() {
+      for (size_t rank = t; rank < ranks.size(); rank += threads)
+        ranks[rank].normalizeTo(t0);
+    });
+  for (auto & worker : workers)
+    worker.join();
+
+  globalRankData = std::move(ranks);
+  return true;
 }
 
 std::pair<sys_clk::time_point, sys_clk::time_point>
@@ -573,23 +2435,32 @@ EventRegistry::collectInitAndFinalize()
 
 }
 
-size_t EventRegistry::getMaxNameWidth()
+size_t EventRegistry::getMaxNameWidth(std::vector<RankData> const & ranks)
+{
+  size_t maxEventWidth = 0;
+  for (auto const & rank : ranks)
+    for (auto & ev : rank.evData)
+      maxEventWidth = std::max(maxEventWidth, ev.first.size());
+
+  return maxEventWidth;
+}
+
+size_t EventRegistry::getMaxNameWidth(std::map<std::string, GlobalEventStats> const & stats)
 {
   size_t maxEventWidth = 0;
-  for (auto & ev : localRankData.evData)
-    if (ev.second.getName().size() > maxEventWidth)
-      maxEventWidth = ev.second.getName().size();
+  for (auto & ev : stats)
+    maxEventWidth = std::max(maxEventWidth, ev.first.size());
 
   return maxEventWidth;
 }
 
-std::pair<sys_clk::time_point, sys_clk::time_point> EventRegistry::findFirstAndLastTime()
+std::pair<sys_clk::time_point, sys_clk::time_point> EventRegistry::findFirstAndLastTime(std::vector<RankData> const & ranks)
 {
-  using T = decltype(globalRankData)::value_type const &;
-  auto first = std::min_element(std::begin(globalRankData), std::end(globalRankData),
+  using T = RankData const &;
+  auto first = std::min_element(std::begin(ranks), std::end(ranks),
                                 [] (T a, T b)
                                 { return a.initializedAt < b.initializedAt; });
-  auto last = std::max_element(std::begin(globalRankData), std::end(globalRankData),
+  auto last = std::max_element(std::begin(ranks), std::end(ranks),
                                [] (T a, T b)
                                { return a.finalizedAt < b.finalizedAt; });
 
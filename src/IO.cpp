@@ -0,0 +1,54 @@
+#include "EventTimings/EventUtils.hpp"
+
+#include <cstring>
+#include <dlfcn.h>
+
+namespace EventTimings {
+
+namespace {
+
+/// Calls passed by the EventTimingsIO library
+char const * const calls[] = {"open", "read", "write", "pread", "pwrite", "fsync"};
+
+/// Call slots of calls, looked up by setIOHooks before the hook is registered
+int slots[sizeof(calls) / sizeof(calls[0])];
+
+/// Hook passed to the EventTimingsIO library
+void countIO(char const * call, long bytes, long long nanoseconds)
+{
+  // POSIX I/O of MPI-IO calls is counted as part of them, I/O while holding the lock of the registry not at all
+  if (detail::mpiIODepth > 0 or detail::untracked)
+    return;
+  auto & registry = EventRegistry::instance();
+  for (size_t i = 0; i < sizeof(calls) / sizeof(calls[0]); ++i) {
+    if (std::strcmp(call, calls[i]) == 0) {
+      registry.putCall(slots[i], bytes, std::chrono::nanoseconds(nanoseconds));
+      return;
+    }
+  }
+  registry.putIOCall(call, bytes, std::chrono::nanoseconds(nanoseconds));
+}
+
+}
+
+namespace detail {
+
+thread_local int mpiIODepth = 0;
+
+void setIOHooks(bool enabled)
+{
+  using Hook = void (*)(char const *, long, long long);
+  using SetHook = void (*)(Hook);
+  // Defined by the EventTimingsIO library, when it is preloaded or linked
+  auto setHook = reinterpret_cast<SetHook>(dlsym(RTLD_DEFAULT, "eventtimings_set_io_hook"));
+  if (not setHook)
+    return;
+  if (enabled)
+    for (size_t i = 0; i < sizeof(calls) / sizeof(calls[0]); ++i)
+      slots[i] = EventRegistry::instance().getCallSlot("io", calls[i]);
+  setHook(enabled ? &countIO : nullptr);
+}
+
+}
+
+}
@@ -0,0 +1,191 @@
+// Interposes POSIX I/O to count it per event, built as the EventTimingsIO library.
+// Preload it by LD_PRELOAD=libEventTimingsIO.so or link it to the application.
+// The EventRegistry registers its hook by eventtimings_set_io_hook on initialize,
+// so the library does not depend on EventTimings. It forwards to the next definition, usually of libc.
+//
+// Only file descriptors returned by the wrapped open calls are counted, not sockets, pipes or terminals,
+// so the I/O of MPI itself is not counted. stdio calls the I/O of libc internally, so it is not counted.
+#undef _FORTIFY_SOURCE // Fortified headers define inline versions of open and read
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace {
+
+using Hook = void (*)(char const * call, long bytes, long long nanoseconds);
+
+std::atomic<Hook> hook{nullptr};
+
+/// Marks file descriptors opened by the wrapped open calls
+constexpr int maxFiles = 1 << 16;
+
+std::atomic<bool> files[maxFiles];
+
+bool isFile(int fd)
+{
+  return fd >= 0 and fd < maxFiles and files[fd].load(std::memory_order_relaxed);
+}
+
+void track(int fd, bool file)
+{
+  if (fd >= 0 and fd < maxFiles)
+    files[fd].store(file, std::memory_order_relaxed);
+}
+
+/// Returns the next definition of the function name, i.e., the one we wrap
+template<class Function>
+Function next(char const * name)
+{
+  return reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+}
+
+long long nanoseconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// Runs a call transferring data on fd, counts it, if fd is a file
+template<class Call>
+ssize_t transfer(char const * name, int fd, Call call)
+{
+  Hook h = hook.load(std::memory_order_relaxed);
+  if (h == nullptr or not isFile(fd))
+    return call();
+  auto const start = std::chrono::steady_clock::now();
+  ssize_t const ret = call();
+  h(name, ret > 0 ? ret : 0, nanoseconds(start));
+  return ret;
+}
+
+/// Runs a call on fd without data, e.g. fsync, counts it, if fd is a file
+template<class Call>
+int control(char const * name, int fd, Call call)
+{
+  Hook h = hook.load(std::memory_order_relaxed);
+  if (h == nullptr or not isFile(fd))
+    return call();
+  auto const start = std::chrono::steady_clock::now();
+  int const ret = call();
+  h(name, 0, nanoseconds(start));
+  return ret;
+}
+
+/// Runs a call opening a file, tracks and counts the returned file descriptor
+template<class Call>
+int opening(char const * name, Call call)
+{
+  auto const start = std::chrono::steady_clock::now();
+  int const fd = call();
+  track(fd, true);
+  Hook h = hook.load(std::memory_order_relaxed);
+  if (h and fd >= 0)
+    h(name, 0, nanoseconds(start));
+  return fd;
+}
+
+/// Returns the mode argument of open, that is only given when creating a file
+mode_t modeOf(int flags, va_list args)
+{
+  return (flags & O_CREAT) or (flags & O_TMPFILE) == O_TMPFILE ? va_arg(args, mode_t) : 0;
+}
+
+}
+
+extern "C" {
+
+__attribute__((visibility("default")))
+void eventtimings_set_io_hook(Hook h)
+{
+  hook.store(h);
+}
+
+int open(const char * path, int flags, ...)
+{
+  static auto const real = next<int (*)(const char *, int, ...)>("open");
+  va_list args;
+  va_start(args, flags);
+  mode_t const mode = modeOf(flags, args);
+  va_end(args);
+  return opening("open", [&] { return real(path, flags, mode); });
+}
+
+int open64(const char * path, int flags, ...)
+{
+  static auto const real = next<int (*)(const char *, int, ...)>("open64");
+  va_list args;
+  va_start(args, flags);
+  mode_t const mode = modeOf(flags, args);
+  va_end(args);
+  return opening("open", [&] { return real(path, flags, mode); });
+}
+
+int openat(int dirfd, const char * path, int flags, ...)
+{
+  static auto const real = next<int (*)(int, const char *, int, ...)>("openat");
+  va_list args;
+  va_start(args, flags);
+  mode_t const mode = modeOf(flags, args);
+  va_end(args);
+  return opening("open", [&] { return real(dirfd, path, flags, mode); });
+}
+
+int close(int fd)
+{
+  static auto const real = next<int (*)(int)>("close");
+  track(fd, false);
+  return real(fd);
+}
+
+ssize_t read(int fd, void * buf, size_t count)
+{
+  static auto const real = next<ssize_t (*)(int, void *, size_t)>("read");
+  return transfer("read", fd, [&] { return real(fd, buf, count); });
+}
+
+ssize_t write(int fd, const void * buf, size_t count)
+{
+  static auto const real = next<ssize_t (*)(int, const void *, size_t)>("write");
+  return transfer("write", fd, [&] { return real(fd, buf, count); });
+}
+
+ssize_t pread(int fd, void * buf, size_t count, off_t offset)
+{
+  static auto const real = next<ssize_t (*)(int, void *, size_t, off_t)>("pread");
+  return transfer("pread", fd, [&] { return real(fd, buf, count, offset); });
+}
+
+ssize_t pread64(int fd, void * buf, size_t count, off64_t offset)
+{
+  static auto const real = next<ssize_t (*)(int, void *, size_t, off64_t)>("pread64");
+  return transfer("pread", fd, [&] { return real(fd, buf, count, offset); });
+}
+
+ssize_t pwrite(int fd, const void * buf, size_t count, off_t offset)
+{
+  static auto const real = next<ssize_t (*)(int, const void *, size_t, off_t)>("pwrite");
+  return transfer("pwrite", fd, [&] { return real(fd, buf, count, offset); });
+}
+
+ssize_t pwrite64(int fd, const void * buf, size_t count, off64_t offset)
+{
+  static auto const real = next<ssize_t (*)(int, const void *, size_t, off64_t)>("pwrite64");
+  return transfer("pwrite", fd, [&] { return real(fd, buf, count, offset); });
+}
+
+int fsync(int fd)
+{
+  static auto const real = next<int (*)(int)>("fsync");
+  return control("fsync", fd, [&] { return real(fd); });
+}
+
+int fdatasync(int fd)
+{
+  static auto const real = next<int (*)(int)>("fdatasync");
+  return control("fsync", fd, [&] { return real(fd); });
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "EventTimings/Event.hpp"
+#include <mutex>
+
+namespace EventTimings {
+
+/// Locks the mutex of the EventRegistry and stops counting allocations of the thread meanwhile.
+/** Counting an allocation may flush the buffer of the thread, which locks the mutex again. */
+class Lock
+{
+public:
+  explicit Lock(std::mutex & mutex)
+    : lock(mutex), untracked(detail::untracked)
+  {
+    detail::untracked = true;
+  }
+
+  ~Lock()
+  {
+    detail::untracked = untracked;
+  }
+
+private:
+  std::lock_guard<std::mutex> lock;
+  bool const untracked;
+};
+
+}
@@ -0,0 +1,230 @@
+#include "EventTimings/LogReader.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace EventTimings {
+namespace binary {
+
+namespace {
+
+/// Returns whether a section is aligned and lies within a block of the given size
+bool contains(Section const & section, std::uint64_t entrySize, std::uint64_t blockSize)
+{
+  return section.offset % 8 == 0 and section.offset <= blockSize
+    and section.size <= (blockSize - section.offset) / entrySize;
+}
+
+/// Returns an error message, if the block at offset is invalid
+std::string validate(char const * log, std::uint64_t offset, std::uint64_t length)
+{
+  std::string const at = " at byte " + std::to_string(offset);
+  Header h;
+  if (length - offset < sizeof(h))
+    return "Truncated header" + at;
+  std::memcpy(&h, log + offset, sizeof(h));
+  if (not std::equal(std::begin(magic), std::end(magic), h.magic))
+    return "No binary event log" + at;
+  if (h.version != version)
+    return "Unsupported version " + std::to_string(h.version) + at;
+  if (h.blockSize < sizeof(h) or h.blockSize % 8 != 0 or h.blockSize > length - offset)
+    return "Invalid or truncated block" + at;
+  if (not contains(h.strings, 1, h.blockSize) or not contains(h.events, sizeof(Event), h.blockSize)
+      or not contains(h.stateChanges, sizeof(StateChange), h.blockSize)
+      or not contains(h.dataKeys, sizeof(DataKey), h.blockSize)
+      or not contains(h.dataValues, sizeof(std::int32_t), h.blockSize)
+      or not contains(h.metrics, sizeof(Metric), h.blockSize) or not contains(h.sent, sizeof(Sent), h.blockSize)
+      or not contains(h.nodes, sizeof(Node), h.blockSize) or not contains(h.counters, sizeof(Counter), h.blockSize)
+      or not contains(h.samples, sizeof(Sample), h.blockSize) or not contains(h.decisions, sizeof(Decision), h.blockSize)
+      or not contains(h.intervals, sizeof(Interval), h.blockSize)
+      or not contains(h.timeline, sizeof(std::uint64_t), h.blockSize)
+      or not contains(h.checkpoints, sizeof(Checkpoint), h.blockSize)
+      or not contains(h.open, sizeof(std::uint64_t), h.blockSize))
+    return "Section exceeds the block" + at;
+  return "";
+}
+
+}
+
+Block::Block(char const * data)
+  : data(data)
+{
+  auto const events = this->events();
+  byName.resize(events.size());
+  for (std::uint32_t i = 0; i < byName.size(); ++i)
+    byName[i] = i;
+  // Usually sorted already, as written by EventTimings
+  auto const less = [&](std::uint32_t a, std::uint32_t b) {
+    auto const nameB = string(events[b].name);
+    return string(events[a].name).compare(nameB.data(), nameB.size()) < 0;
+  };
+  if (not std::is_sorted(byName.begin(), byName.end(), less))
+    std::sort(byName.begin(), byName.end(), less);
+}
+
+StringView Block::string(String s) const
+{
+  auto const & strings = header().strings;
+  auto const offset = std::min(s.offset, strings.size);
+  return StringView(data + strings.offset + offset, std::min(s.length, strings.size - offset));
+}
+
+Event const * Block::event(std::string const & name) const
+{
+  auto const events = this->events();
+  auto const found = std::lower_bound(byName.begin(), byName.end(), name, [&](std::uint32_t e, std::string const & n) {
+    return string(events[e].name).compare(n.data(), n.size()) < 0;
+  });
+  if (found == byName.end() or string(events[*found].name) != name)
+    return nullptr;
+  return &events[*found];
+}
+
+std::vector<Interval const *> Block::intervals(std::int64_t from, std::int64_t to) const
+{
+  auto const timeline = this->timeline();
+  return overlapping(&timeline, {0, timeline.size()}, header().timelineCheckpoints, from, to);
+}
+
+std::vector<Interval const *> Block::intervals(Event const & event, std::int64_t from, std::int64_t to) const
+{
+  auto const & intervals = header().intervals;
+  auto const first = std::min(event.intervals.first, intervals.size);
+  return overlapping(nullptr, {first, std::min(event.intervals.size, intervals.size - first)}, event.checkpoints, from, to);
+}
+
+std::vector<Interval const *> Block::overlapping(View<std::uint64_t> const * index, Range positions, Range checkpoints,
+                                                 std::int64_t from, std::int64_t to) const
+{
+  std::vector<Interval const *> found;
+  auto const all = section<Interval>(header().intervals);
+  // Indices are not validated when the log is opened, invalid ones are skipped
+  auto const at = [&](std::uint64_t index) { return index < all.size() ? &all[index] : nullptr; };
+  auto const interval = [&](std::uint64_t position) { return at(index ? (*index)[position] : positions.first + position); };
+  auto const add = [&](Interval const * i) {
+    if (i and i->stop >= from and i->start <= to)
+      found.push_back(i);
+  };
+
+  // The first position, that starts at or after from
+  std::uint64_t begin = 0;
+  for (std::uint64_t count = positions.size; count > 0; ) {
+    auto const half = count / 2;
+    auto const i = interval(begin + half);
+    if (i and i->start < from) {
+      begin += half + 1;
+      count -= half + 1;
+    }
+    else
+      count = half;
+  }
+
+  // Intervals, that started before from, are open at the checkpoint before begin or lie between it and begin
+  auto const step = header().checkpointInterval;
+  if (begin > 0 and step > 0) {
+    auto const checkpoint = (begin - 1) / step;
+    auto const views = range<Checkpoint>(header().checkpoints, checkpoints);
+    if (checkpoint < views.size())
+      for (auto index : range<std::uint64_t>(header().open, views[checkpoint].open))
+        add(at(index));
+    for (auto position = checkpoint * step; position < begin; ++position)
+      add(interval(position));
+  }
+  for (auto position = begin; position < positions.size; ++position) {
+    auto const i = interval(position);
+    if (i and i->start > to)
+      break;
+    add(i);
+  }
+  return found;
+}
+
+Log::Log(std::string const & file)
+{
+  open(file);
+}
+
+Log::Log(Log && other)
+{
+  *this = std::move(other);
+}
+
+Log & Log::operator=(Log && other)
+{
+  if (this != &other) {
+    close();
+    mapped = other.mapped;
+    length = other.length;
+    blocks = std::move(other.blocks);
+    ranks = std::move(other.ranks);
+    error = std::move(other.error);
+    other.mapped = nullptr;
+    other.length = 0;
+  }
+  return *this;
+}
+
+Log::~Log()
+{
+  close();
+}
+
+bool Log::open(std::string const & file)
+{
+  close();
+  int const fd = ::open(file.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd == -1 or fstat(fd, &st) != 0) {
+    error = "Cannot open " + file + ": " + std::strerror(errno);
+    if (fd != -1)
+      ::close(fd);
+    return false;
+  }
+  length = st.st_size;
+  void * m = length > 0 ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  ::close(fd);
+  if (m == MAP_FAILED) {
+    error = length > 0 ? "Cannot map " + file + ": " + std::strerror(errno) : file + " is empty";
+    length = 0;
+    return false;
+  }
+  mapped = m;
+
+  auto const log = static_cast<char const *>(mapped);
+  for (std::uint64_t offset = 0; offset < length; ) {
+    error = validate(log, offset, length);
+    if (not error.empty()) {
+      error = file + ": " + error;
+      close();
+      return false;
+    }
+    blocks.emplace_back(log + offset);
+    ranks[blocks.back().rank()] = blocks.size() - 1;
+    offset += blocks.back().header().blockSize;
+  }
+  error.clear();
+  return true;
+}
+
+void Log::close()
+{
+  if (mapped)
+    munmap(mapped, length);
+  mapped = nullptr;
+  length = 0;
+  blocks.clear();
+  ranks.clear();
+}
+
+Block const * Log::rank(int rank) const
+{
+  auto const found = ranks.find(rank);
+  return found == ranks.end() ? nullptr : &blocks[found->second];
+}
+
+}
+}
@@ -0,0 +1,114 @@
+// Interposes malloc and free to count allocations per event, built as the EventTimingsMalloc library.
+// Preload it by LD_PRELOAD=libEventTimingsMalloc.so or link it to the application.
+// The EventRegistry registers its hooks by eventtimings_set_allocation_hooks on initialize,
+// so the library does not depend on EventTimings. It forwards to the glibc allocator.
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <malloc.h>
+
+extern "C" {
+
+void * __libc_malloc(std::size_t size);
+void * __libc_calloc(std::size_t count, std::size_t size);
+void * __libc_realloc(void * ptr, std::size_t size);
+void * __libc_memalign(std::size_t alignment, std::size_t size);
+void * __libc_valloc(std::size_t size);
+void * __libc_pvalloc(std::size_t size);
+void __libc_free(void * ptr);
+
+}
+
+namespace {
+
+using Hook = void (*)(std::size_t);
+
+std::atomic<Hook> onAllocate{nullptr}, onFree{nullptr};
+
+/// Counts the usable size, so allocations and frees of the same memory balance
+inline void * allocated(void * ptr)
+{
+  Hook hook = onAllocate.load(std::memory_order_relaxed);
+  if (hook and ptr)
+    hook(malloc_usable_size(ptr));
+  return ptr;
+}
+
+inline void freeing(void * ptr)
+{
+  Hook hook = onFree.load(std::memory_order_relaxed);
+  if (hook and ptr)
+    hook(malloc_usable_size(ptr));
+}
+
+}
+
+extern "C" {
+
+__attribute__((visibility("default")))
+void eventtimings_set_allocation_hooks(Hook allocate, Hook free)
+{
+  onAllocate.store(allocate);
+  onFree.store(free);
+}
+
+void * malloc(std::size_t size)
+{
+  return allocated(__libc_malloc(size));
+}
+
+void * calloc(std::size_t count, std::size_t size)
+{
+  return allocated(__libc_calloc(count, size));
+}
+
+void * realloc(void * ptr, std::size_t size)
+{
+  Hook hook = onFree.load(std::memory_order_relaxed);
+  std::size_t const previous = hook and ptr ? malloc_usable_size(ptr) : 0;
+  void * p = __libc_realloc(ptr, size);
+  if (p == nullptr and size != 0) // Failed, ptr is still allocated
+    return p;
+  if (hook and ptr)
+    hook(previous);
+  return allocated(p);
+}
+
+void free(void * ptr)
+{
+  freeing(ptr);
+  __libc_free(ptr);
+}
+
+void * memalign(std::size_t alignment, std::size_t size)
+{
+  return allocated(__libc_memalign(alignment, size));
+}
+
+void * aligned_alloc(std::size_t alignment, std::size_t size)
+{
+  return allocated(__libc_memalign(alignment, size));
+}
+
+void * valloc(std::size_t size)
+{
+  return allocated(__libc_valloc(size));
+}
+
+void * pvalloc(std::size_t size)
+{
+  return allocated(__libc_pvalloc(size));
+}
+
+int posix_memalign(void ** ptr, std::size_t alignment, std::size_t size)
+{
+  if (alignment % sizeof(void *) != 0 or (alignment & (alignment - 1)) != 0)
+    return EINVAL;
+  void * p = __libc_memalign(alignment, size);
+  if (p == nullptr and size != 0)
+    return ENOMEM;
+  *ptr = allocated(p);
+  return 0;
+}
+
+}
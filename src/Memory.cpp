@@ -0,0 +1,64 @@
+#include "EventTimings/Memory.hpp"
+#include "EventTimings/Event.hpp"
+
+#include <dlfcn.h>
+
+namespace EventTimings {
+
+namespace {
+
+/// Returns the sums of the innermost running event in the buffer of the calling thread, nullptr if there is none
+detail::MemorySums * sums()
+{
+  if (detail::untracked)
+    return nullptr;
+  int const id = detail::runningEvent(); // the thread has a buffer, if an event is running
+  if (id < 0)
+    return nullptr;
+  auto & memory = detail::buffer->memory;
+  if (static_cast<std::size_t>(id) >= memory.size()) {
+    // Growing allocates, which must not be counted into the sums being grown
+    detail::untracked = true;
+    memory.resize(id + 1);
+    detail::untracked = false;
+  }
+  return &memory[id];
+}
+
+}
+
+void countAllocation(std::size_t bytes)
+{
+  if (auto s = sums()) {
+    s->allocations++;
+    s->allocated += bytes;
+  }
+}
+
+void countFree(std::size_t bytes)
+{
+  if (auto s = sums()) {
+    s->frees++;
+    s->freed += bytes;
+  }
+}
+
+namespace detail {
+
+void setAllocationHooks(bool enabled)
+{
+  using Hook = void (*)(std::size_t);
+  using SetHooks = void (*)(Hook, Hook);
+  // Defined by the EventTimingsMalloc library, when it is preloaded or linked
+  auto setHooks = reinterpret_cast<SetHooks>(dlsym(RTLD_DEFAULT, "eventtimings_set_allocation_hooks"));
+  if (setHooks == nullptr)
+    return;
+  if (enabled)
+    setHooks(&countAllocation, &countFree);
+  else
+    setHooks(nullptr, nullptr);
+}
+
+}
+
+}
@@ -0,0 +1,497 @@
+// Wrappers of common MPI calls using the PMPI profiling interface.
+// Linking the EventTimingsPMPI library before MPI records the time and bytes of every wrapped call
+// as metrics of the innermost running event, see EventRegistry::putCall. Every wrapper looks the slot of its
+// call up once, the calls are summed up in the buffer of the thread without locking.
+//
+// Bytes are the bytes sent by this rank. For receiving calls and MPI_Get, they are the bytes received.
+// Point-to-point sends, MPI_Put and MPI_Accumulate are also added to the communication matrix,
+// see EventRegistry::putMessage. MPI-IO calls are recorded as I/O, with group "io".
+#include <mpi.h>
+#include <vector>
+#include "EventTimings/EventUtils.hpp"
+
+using namespace EventTimings;
+
+namespace {
+
+using Clock = Event::Clock;
+
+/// Returns the size of count elements of type in bytes
+long bytes(int count, MPI_Datatype type)
+{
+  if (type == MPI_DATATYPE_NULL or count <= 0)
+    return 0;
+  int size;
+  PMPI_Type_size(type, &size);
+  return static_cast<long>(count) * size;
+}
+
+/// Returns the size of the elements given by counts for all ranks of comm in bytes
+long bytes(int const counts[], MPI_Datatype type, MPI_Comm comm)
+{
+  int size;
+  PMPI_Comm_size(comm, &size);
+  long total = 0;
+  for (int i = 0; i < size; ++i)
+    total += bytes(counts[i], type);
+  return total;
+}
+
+/// Returns the number of ranks in comm
+int commSize(MPI_Comm comm)
+{
+  int size;
+  PMPI_Comm_size(comm, &size);
+  return size;
+}
+
+/// Returns the bytes received as given by status
+long received(MPI_Status const * status, MPI_Datatype type)
+{
+  int count;
+  PMPI_Get_count(status, type, &count);
+  return count == MPI_UNDEFINED ? 0 : bytes(count, type);
+}
+
+/// Ranks of a group in the communicator of the EventRegistry, cached as attribute of a communicator or window
+struct Translation
+{
+  /// Communicator of the EventRegistry, when the ranks were translated
+  MPI_Comm registry;
+
+  /// Rank in the communicator of the EventRegistry by rank in the group, -1 if it is not contained
+  std::vector<int> ranks;
+};
+
+/// Translates all ranks of group to the communicator of the EventRegistry
+void translate(MPI_Group group, Translation & translation)
+{
+  translation.registry = EventRegistry::instance().getMPIComm();
+  MPI_Group registryGroup;
+  PMPI_Comm_group(translation.registry, &registryGroup);
+  int size;
+  PMPI_Group_size(group, &size);
+  std::vector<int> ranks(size);
+  for (int i = 0; i < size; ++i)
+    ranks[i] = i;
+  translation.ranks.resize(size);
+  PMPI_Group_translate_ranks(group, size, ranks.data(), registryGroup, translation.ranks.data());
+  PMPI_Group_free(&registryGroup);
+  for (auto & rank : translation.ranks)
+    if (rank == MPI_UNDEFINED)
+      rank = -1;
+}
+
+int deleteTranslation(MPI_Comm, int, void * translation, void *)
+{
+  delete static_cast<Translation *>(translation);
+  return MPI_SUCCESS;
+}
+
+int deleteWinTranslation(MPI_Win, int, void * translation, void *)
+{
+  delete static_cast<Translation *>(translation);
+  return MPI_SUCCESS;
+}
+
+/// Returns the rank in the communicator of the EventRegistry of rank in comm or win, -1 if it is not contained.
+/** The translation of all ranks is cached as attribute, so it is freed with the communicator or window. */
+template<class Handle>
+int translate(int rank, Handle handle,
+              int (*getAttr)(Handle, int, void *, int *), int (*setAttr)(Handle, int, void *),
+              int (*getGroup)(Handle, MPI_Group *), int keyval)
+{
+  Translation * translation;
+  int found;
+  getAttr(handle, keyval, &translation, &found);
+  if (not found) {
+    translation = new Translation;
+    setAttr(handle, keyval, translation);
+  }
+  if (not found or translation->registry != EventRegistry::instance().getMPIComm()) {
+    MPI_Group group;
+    getGroup(handle, &group);
+    translate(group, *translation);
+    PMPI_Group_free(&group);
+  }
+  return rank < static_cast<int>(translation->ranks.size()) ? translation->ranks[rank] : -1;
+}
+
+int translate(int rank, MPI_Comm comm)
+{
+  static int keyval = MPI_KEYVAL_INVALID;
+  if (keyval == MPI_KEYVAL_INVALID)
+    PMPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, deleteTranslation, &keyval, nullptr);
+  return translate(rank, comm, PMPI_Comm_get_attr, PMPI_Comm_set_attr, PMPI_Comm_group, keyval);
+}
+
+int translate(int rank, MPI_Win win)
+{
+  static int keyval = MPI_KEYVAL_INVALID;
+  if (keyval == MPI_KEYVAL_INVALID)
+    PMPI_Win_create_keyval(MPI_WIN_NULL_COPY_FN, deleteWinTranslation, &keyval, nullptr);
+  return translate(rank, win, PMPI_Win_get_attr, PMPI_Win_set_attr, PMPI_Win_get_group, keyval);
+}
+
+/// Adds a message to rank dest of comm to the communication matrix
+void message(int dest, MPI_Comm comm, long bytes)
+{
+  if (dest < 0 or detail::runningEvent() < 0) // MPI_PROC_NULL or outside of events
+    return;
+  auto & registry = EventRegistry::instance();
+  if (comm != registry.getMPIComm())
+    dest = translate(dest, comm);
+  registry.putMessage(dest, bytes);
+}
+
+/// Adds a message to rank target of the group of win to the communication matrix
+void message(int target, MPI_Win win, long bytes)
+{
+  if (target < 0 or detail::runningEvent() < 0)
+    return;
+  EventRegistry::instance().putMessage(translate(target, win), bytes);
+}
+
+/// Runs the PMPI call and passes its duration to the EventRegistry
+/** Every wrapper passes its own lambda, so the static slot is looked up once per wrapper. */
+template<class Call>
+int timed(char const * name, long bytes, Call call)
+{
+  static int const slot = EventRegistry::instance().getCallSlot("mpi", name);
+  auto const start = Clock::now();
+  int const ret = call();
+  EventRegistry::instance().putCall(slot, bytes, Clock::now() - start);
+  return ret;
+}
+
+/// Runs the PMPI-IO call and passes its duration to the EventRegistry as I/O
+template<class Call>
+int timedIO(char const * name, long bytes, Call call)
+{
+  static int const slot = EventRegistry::instance().getCallSlot("io", name);
+  auto const start = Clock::now();
+  detail::mpiIODepth++;
+  int const ret = call();
+  detail::mpiIODepth--;
+  EventRegistry::instance().putCall(slot, bytes, Clock::now() - start);
+  return ret;
+}
+
+}
+
+// ----------------------------------------------------------------------- Point-to-point
+
+int MPI_Send(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm)
+{
+  long const sent = bytes(count, datatype);
+  message(dest, comm, sent);
+  return timed("Send", sent,
+               [&] { return PMPI_Send(buf, count, datatype, dest, tag, comm); });
+}
+
+int MPI_Ssend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm)
+{
+  long const sent = bytes(count, datatype);
+  message(dest, comm, sent);
+  return timed("Ssend", sent,
+               [&] { return PMPI_Ssend(buf, count, datatype, dest, tag, comm); });
+}
+
+int MPI_Isend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm,
+              MPI_Request *request)
+{
+  long const sent = bytes(count, datatype);
+  message(dest, comm, sent);
+  return timed("Isend", sent,
+               [&] { return PMPI_Isend(buf, count, datatype, dest, tag, comm, request); });
+}
+
+int MPI_Recv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm,
+             MPI_Status *status)
+{
+  MPI_Status own;
+  if (status == MPI_STATUS_IGNORE)
+    status = &own;
+  static int const slot = EventRegistry::instance().getCallSlot("mpi", "Recv");
+  auto const start = Clock::now();
+  int const ret = PMPI_Recv(buf, count, datatype, source, tag, comm, status);
+  auto const duration = Clock::now() - start;
+  EventRegistry::instance().putCall(slot, received(status, datatype), duration);
+  return ret;
+}
+
+int MPI_Irecv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm,
+              MPI_Request *request)
+{
+  return timed("Irecv", bytes(count, datatype),
+               [&] { return PMPI_Irecv(buf, count, datatype, source, tag, comm, request); });
+}
+
+int MPI_Sendrecv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, int dest, int sendtag,
+                 void *recvbuf, int recvcount, MPI_Datatype recvtype, int source, int recvtag,
+                 MPI_Comm comm, MPI_Status *status)
+{
+  long const sent = bytes(sendcount, sendtype);
+  message(dest, comm, sent);
+  return timed("Sendrecv", sent,
+               [&] { return PMPI_Sendrecv(sendbuf, sendcount, sendtype, dest, sendtag,
+                                          recvbuf, recvcount, recvtype, source, recvtag, comm, status); });
+}
+
+// ----------------------------------------------------------------------- Waits
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status)
+{
+  return timed("Wait", 0, [&] { return PMPI_Wait(request, status); });
+}
+
+int MPI_Waitall(int count, MPI_Request array_of_requests[], MPI_Status *array_of_statuses)
+{
+  return timed("Waitall", 0, [&] { return PMPI_Waitall(count, array_of_requests, array_of_statuses); });
+}
+
+int MPI_Waitany(int count, MPI_Request array_of_requests[], int *index, MPI_Status *status)
+{
+  return timed("Waitany", 0, [&] { return PMPI_Waitany(count, array_of_requests, index, status); });
+}
+
+int MPI_Waitsome(int incount, MPI_Request array_of_requests[], int *outcount, int array_of_indices[],
+                 MPI_Status array_of_statuses[])
+{
+  return timed("Waitsome", 0, [&] {
+      return PMPI_Waitsome(incount, array_of_requests, outcount, array_of_indices, array_of_statuses);
+    });
+}
+
+// ----------------------------------------------------------------------- Collectives
+
+int MPI_Barrier(MPI_Comm comm)
+{
+  return timed("Barrier", 0, [&] { return PMPI_Barrier(comm); });
+}
+
+int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm)
+{
+  return timed("Bcast", bytes(count, datatype),
+               [&] { return PMPI_Bcast(buffer, count, datatype, root, comm); });
+}
+
+int MPI_Reduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op,
+               int root, MPI_Comm comm)
+{
+  return timed("Reduce", bytes(count, datatype),
+               [&] { return PMPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm); });
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op,
+                  MPI_Comm comm)
+{
+  return timed("Allreduce", bytes(count, datatype),
+               [&] { return PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm); });
+}
+
+int MPI_Reduce_scatter(const void *sendbuf, void *recvbuf, const int recvcounts[], MPI_Datatype datatype,
+                       MPI_Op op, MPI_Comm comm)
+{
+  return timed("Reduce_scatter", bytes(recvcounts, datatype, comm),
+               [&] { return PMPI_Reduce_scatter(sendbuf, recvbuf, recvcounts, datatype, op, comm); });
+}
+
+int MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+               void *recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+  long const sent = sendbuf == MPI_IN_PLACE ? bytes(recvcount, recvtype) : bytes(sendcount, sendtype);
+  return timed("Gather", sent, [&] {
+      return PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    });
+}
+
+int MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                void *recvbuf, const int recvcounts[], const int displs[], MPI_Datatype recvtype,
+                int root, MPI_Comm comm)
+{
+  long const sent = sendbuf == MPI_IN_PLACE ? 0 : bytes(sendcount, sendtype);
+  return timed("Gatherv", sent, [&] {
+      return PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm);
+    });
+}
+
+int MPI_Allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                  void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm)
+{
+  long const sent = sendbuf == MPI_IN_PLACE ? bytes(recvcount, recvtype) : bytes(sendcount, sendtype);
+  return timed("Allgather", sent, [&] {
+      return PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+    });
+}
+
+int MPI_Allgatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                   void *recvbuf, const int recvcounts[], const int displs[], MPI_Datatype recvtype,
+                   MPI_Comm comm)
+{
+  long const sent = sendbuf == MPI_IN_PLACE ? 0 : bytes(sendcount, sendtype);
+  return timed("Allgatherv", sent, [&] {
+      return PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm);
+    });
+}
+
+int MPI_Scatter(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                void *recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+  long const received = recvbuf == MPI_IN_PLACE ? 0 : bytes(recvcount, recvtype);
+  return timed("Scatter", received, [&] {
+      return PMPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    });
+}
+
+int MPI_Scatterv(const void *sendbuf, const int sendcounts[], const int displs[], MPI_Datatype sendtype,
+                 void *recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+  long const received = recvbuf == MPI_IN_PLACE ? 0 : bytes(recvcount, recvtype);
+  return timed("Scatterv", received, [&] {
+      return PMPI_Scatterv(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    });
+}
+
+int MPI_Alltoall(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                 void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm)
+{
+  long const sent = sendbuf == MPI_IN_PLACE ? bytes(recvcount, recvtype) * commSize(comm)
+                                            : bytes(sendcount, sendtype) * commSize(comm);
+  return timed("Alltoall", sent, [&] {
+      return PMPI_Alltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+    });
+}
+
+int MPI_Alltoallv(const void *sendbuf, const int sendcounts[], const int sdispls[], MPI_Datatype sendtype,
+                  void *recvbuf, const int recvcounts[], const int rdispls[], MPI_Datatype recvtype,
+                  MPI_Comm comm)
+{
+  long const sent = sendbuf == MPI_IN_PLACE ? bytes(recvcounts, recvtype, comm)
+                                            : bytes(sendcounts, sendtype, comm);
+  return timed("Alltoallv", sent, [&] {
+      return PMPI_Alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
+    });
+}
+
+// ----------------------------------------------------------------------- One-sided
+
+int MPI_Put(const void *origin_addr, int origin_count, MPI_Datatype origin_datatype, int target_rank,
+            MPI_Aint target_disp, int target_count, MPI_Datatype target_datatype, MPI_Win win)
+{
+  long const sent = bytes(origin_count, origin_datatype);
+  message(target_rank, win, sent);
+  return timed("Put", sent, [&] {
+      return PMPI_Put(origin_addr, origin_count, origin_datatype, target_rank,
+                      target_disp, target_count, target_datatype, win);
+    });
+}
+
+int MPI_Get(void *origin_addr, int origin_count, MPI_Datatype origin_datatype, int target_rank,
+            MPI_Aint target_disp, int target_count, MPI_Datatype target_datatype, MPI_Win win)
+{
+  return timed("Get", bytes(origin_count, origin_datatype), [&] {
+      return PMPI_Get(origin_addr, origin_count, origin_datatype, target_rank,
+                      target_disp, target_count, target_datatype, win);
+    });
+}
+
+int MPI_Accumulate(const void *origin_addr, int origin_count, MPI_Datatype origin_datatype, int target_rank,
+                   MPI_Aint target_disp, int target_count, MPI_Datatype target_datatype, MPI_Op op, MPI_Win win)
+{
+  long const sent = bytes(origin_count, origin_datatype);
+  message(target_rank, win, sent);
+  return timed("Accumulate", sent, [&] {
+      return PMPI_Accumulate(origin_addr, origin_count, origin_datatype, target_rank,
+                             target_disp, target_count, target_datatype, op, win);
+    });
+}
+
+int MPI_Win_fence(int assert, MPI_Win win)
+{
+  return timed("Win_fence", 0, [&] { return PMPI_Win_fence(assert, win); });
+}
+
+int MPI_Win_lock(int lock_type, int rank, int assert, MPI_Win win)
+{
+  return timed("Win_lock", 0, [&] { return PMPI_Win_lock(lock_type, rank, assert, win); });
+}
+
+int MPI_Win_unlock(int rank, MPI_Win win)
+{
+  return timed("Win_unlock", 0, [&] { return PMPI_Win_unlock(rank, win); });
+}
+
+int MPI_Win_flush(int rank, MPI_Win win)
+{
+  return timed("Win_flush", 0, [&] { return PMPI_Win_flush(rank, win); });
+}
+
+// ----------------------------------------------------------------------- MPI-IO
+
+int MPI_File_open(MPI_Comm comm, const char *filename, int amode, MPI_Info info, MPI_File *fh)
+{
+  return timedIO("File_open", 0, [&] { return PMPI_File_open(comm, filename, amode, info, fh); });
+}
+
+int MPI_File_close(MPI_File *fh)
+{
+  return timedIO("File_close", 0, [&] { return PMPI_File_close(fh); });
+}
+
+int MPI_File_sync(MPI_File fh)
+{
+  return timedIO("File_sync", 0, [&] { return PMPI_File_sync(fh); });
+}
+
+int MPI_File_read(MPI_File fh, void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  return timedIO("File_read", bytes(count, datatype),
+                 [&] { return PMPI_File_read(fh, buf, count, datatype, status); });
+}
+
+int MPI_File_read_all(MPI_File fh, void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  return timedIO("File_read_all", bytes(count, datatype),
+                 [&] { return PMPI_File_read_all(fh, buf, count, datatype, status); });
+}
+
+int MPI_File_read_at(MPI_File fh, MPI_Offset offset, void *buf, int count, MPI_Datatype datatype,
+                     MPI_Status *status)
+{
+  return timedIO("File_read_at", bytes(count, datatype),
+                 [&] { return PMPI_File_read_at(fh, offset, buf, count, datatype, status); });
+}
+
+int MPI_File_read_at_all(MPI_File fh, MPI_Offset offset, void *buf, int count, MPI_Datatype datatype,
+                         MPI_Status *status)
+{
+  return timedIO("File_read_at_all", bytes(count, datatype),
+                 [&] { return PMPI_File_read_at_all(fh, offset, buf, count, datatype, status); });
+}
+
+int MPI_File_write(MPI_File fh, const void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  return timedIO("File_write", bytes(count, datatype),
+                 [&] { return PMPI_File_write(fh, buf, count, datatype, status); });
+}
+
+int MPI_File_write_all(MPI_File fh, const void *buf, int count, MPI_Datatype datatype, MPI_Status *status)
+{
+  return timedIO("File_write_all", bytes(count, datatype),
+                 [&] { return PMPI_File_write_all(fh, buf, count, datatype, status); });
+}
+
+int MPI_File_write_at(MPI_File fh, MPI_Offset offset, const void *buf, int count, MPI_Datatype datatype,
+                      MPI_Status *status)
+{
+  return timedIO("File_write_at", bytes(count, datatype),
+                 [&] { return PMPI_File_write_at(fh, offset, buf, count, datatype, status); });
+}
+
+int MPI_File_write_at_all(MPI_File fh, MPI_Offset offset, const void *buf, int count, MPI_Datatype datatype,
+                          MPI_Status *status)
+{
+  return timedIO("File_write_at_all", bytes(count, datatype),
+                 [&] { return PMPI_File_write_at_all(fh, offset, buf, count, datatype, status); });
+}
@@ -0,0 +1,373 @@
+#include "EventTimings/Probes.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace EventTimings {
+
+namespace {
+
+/// A single counter of a group, opened by perf_event_open
+struct Counter
+{
+  int fd = -1;
+  perf_event_mmap_page * page = nullptr;
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+inline unsigned long long rdpmc(unsigned int counter)
+{
+  unsigned int low, high;
+  asm volatile("rdpmc" : "=a" (low), "=d" (high) : "c" (counter));
+  return low | (static_cast<unsigned long long>(high) << 32);
+}
+
+inline unsigned long long rdtsc()
+{
+  unsigned int low, high;
+  asm volatile("rdtsc" : "=a" (low), "=d" (high));
+  return low | (static_cast<unsigned long long>(high) << 32);
+}
+#endif
+
+/// Counters of a thread, opened as a group by perf_event_open
+class CounterGroup
+{
+public:
+  /// Opens the counters for the calling thread, no counters, if any of them could not be opened
+  CounterGroup(std::vector<std::pair<std::string, perf_event_attr>> const & events)
+  {
+    int leader = -1;
+    for (auto const & event : events) {
+      perf_event_attr attr = event.second;
+      attr.size = sizeof(attr);
+      attr.disabled = leader == -1; // The group is enabled by its leader
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      if (attr.type == PERF_TYPE_HARDWARE) { // Software events, such as context switches, happen in the kernel
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+      }
+      int fd = syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+      if (fd == -1) {
+        close();
+        return;
+      }
+      if (leader == -1)
+        leader = fd;
+
+      Counter counter;
+      counter.fd = fd;
+      void * page = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd, 0);
+      if (page != MAP_FAILED)
+        counter.page = static_cast<perf_event_mmap_page *>(page);
+      counters.push_back(counter);
+    }
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+
+  ~CounterGroup()
+  {
+    close();
+  }
+
+  CounterGroup(CounterGroup const &) = delete;
+  CounterGroup & operator=(CounterGroup const &) = delete;
+
+  bool isOpen() const
+  {
+    return not counters.empty();
+  }
+
+  /// Reads the counters, only by the thread, that opened them, zeros if they are not open
+  void read(long long * values, size_t size) const
+  {
+    for (size_t i = 0; i < size; ++i)
+      values[i] = i < counters.size() ? readUser(counters[i]) : 0;
+  }
+
+private:
+  std::vector<Counter> counters;
+
+  void close()
+  {
+    for (auto & counter : counters) {
+      if (counter.page != nullptr)
+        munmap(counter.page, sysconf(_SC_PAGESIZE));
+      ::close(counter.fd);
+    }
+    counters.clear();
+  }
+
+  /// Scales a count to the time the counter was enabled, as counters are multiplexed, if the PMU has too few of them
+  static long long scale(long long count, unsigned long long enabled, unsigned long long running)
+  {
+    if (running == enabled)
+      return count;
+    if (running == 0)
+      return 0;
+    return static_cast<long long>(static_cast<double>(count) * enabled / running);
+  }
+
+  static long long readSyscall(Counter const & counter)
+  {
+    unsigned long long values[3]; // Value, time enabled and time running, see read_format
+    if (::read(counter.fd, values, sizeof(values)) != sizeof(values))
+      return 0;
+    return scale(values[0], values[1], values[2]);
+  }
+
+  /// Reads the counter by rdpmc, as documented in perf_event_open(2)
+  static long long readUser(Counter const & counter)
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    auto const page = counter.page;
+    if (page == nullptr)
+      return readSyscall(counter);
+
+    unsigned int seq;
+    long long count;
+    unsigned long long enabled, running, delta = 0;
+    do {
+      seq = page->lock;
+      __sync_synchronize();
+      enabled = page->time_enabled;
+      running = page->time_running;
+      unsigned int const index = page->index;
+      if (not page->cap_user_rdpmc or index == 0 or (enabled != running and not page->cap_user_time))
+        return readSyscall(counter);
+      if (enabled != running) { // Adds the time since the times were updated
+        unsigned long long const cycles = rdtsc();
+        unsigned short const shift = page->time_shift;
+        unsigned long long const rem = cycles & ((1ULL << shift) - 1);
+        delta = page->time_offset + (cycles >> shift) * page->time_mult + ((rem * page->time_mult) >> shift);
+      }
+      count = page->offset;
+      long long pmc = rdpmc(index - 1);
+      int const shift = 64 - page->pmc_width;
+      count += static_cast<long long>(static_cast<unsigned long long>(pmc) << shift) >> shift;
+      __sync_synchronize();
+    } while (page->lock != seq);
+    return scale(count, enabled + delta, running + delta);
+#else
+    return readSyscall(counter);
+#endif
+  }
+};
+
+/// Reads counters of the calling thread by perf_event_open, each thread opens its own counters on its first read
+class PerfCounterProbe : public Probe
+{
+public:
+  PerfCounterProbe(std::vector<std::pair<std::string, perf_event_attr>> events)
+    : events(std::move(events)),
+      id(nextId++)
+  {
+    // Opens the counters of the creating thread, so it is known, whether they are available
+    if (group().isOpen())
+      for (auto const & event : this->events)
+        names.push_back(event.first);
+  }
+
+  bool isOpen() const
+  {
+    return not names.empty();
+  }
+
+  std::string getGroup() const override
+  {
+    return "perf";
+  }
+
+  std::vector<std::string> getNames() const override
+  {
+    return names;
+  }
+
+  void read(long long * values) override
+  {
+    group().read(values, names.size());
+  }
+
+private:
+  std::vector<std::pair<std::string, perf_event_attr>> events;
+  std::vector<std::string> names;
+
+  /// Identifies the probe in the counters of the threads, unlike its address it is not reused
+  unsigned id;
+
+  static std::atomic<unsigned> nextId;
+
+  /// Counter groups of the calling thread by the id of their probe, closed when the thread exits.
+  /** Probes live as long as the registry, so the groups are not removed, when a probe is destroyed. */
+  static std::map<unsigned, std::unique_ptr<CounterGroup>> & groups()
+  {
+    static thread_local std::map<unsigned, std::unique_ptr<CounterGroup>> groups;
+    return groups;
+  }
+
+  /// Returns the counters of the calling thread, opens them on the first call of the thread
+  CounterGroup const & group()
+  {
+    auto & group = groups()[id];
+    if (not group)
+      group.reset(new CounterGroup(events));
+    return *group;
+  }
+};
+
+std::atomic<unsigned> PerfCounterProbe::nextId{0};
+
+/// Reads the resource usage of the calling thread, returns its CPU time in nanoseconds
+long long readThreadUsage(rusage & usage)
+{
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  getrusage(RUSAGE_THREAD, &usage);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/// Reads the software counters by getrusage and clock_gettime, if perf_event_open is not permitted at all
+class RUsageProbe : public Probe
+{
+public:
+  std::string getGroup() const override
+  {
+    return "perf";
+  }
+
+  std::vector<std::string> getNames() const override
+  {
+    return {"task-clock", "page-faults", "context-switches"};
+  }
+
+  void read(long long * values) override
+  {
+    rusage usage;
+    values[0] = readThreadUsage(usage);
+    values[1] = usage.ru_minflt + usage.ru_majflt;
+    values[2] = usage.ru_nvcsw + usage.ru_nivcsw;
+  }
+};
+
+/// Reads the CPU time and context switches of the calling thread
+class CPUTimeProbe : public Probe
+{
+public:
+  std::string getGroup() const override
+  {
+    return "cpu";
+  }
+
+  std::vector<std::string> getNames() const override
+  {
+    return {"time", "voluntary-switches", "involuntary-switches"};
+  }
+
+  void read(long long * values) override
+  {
+    rusage usage;
+    values[0] = readThreadUsage(usage);
+    values[1] = usage.ru_nvcsw;
+    values[2] = usage.ru_nivcsw;
+  }
+};
+
+/// Reads the resident set size of the process and its peak from /proc/self/statm and getrusage
+class MemoryProbe : public Probe
+{
+public:
+  MemoryProbe()
+    : statm(open("/proc/self/statm", O_RDONLY)),
+      pageSize(sysconf(_SC_PAGESIZE))
+  {}
+
+  ~MemoryProbe()
+  {
+    if (statm >= 0)
+      close(statm);
+  }
+
+  std::string getGroup() const override
+  {
+    return "memory";
+  }
+
+  std::vector<std::string> getNames() const override
+  {
+    return {"rss", "peak-rss"};
+  }
+
+  void read(long long * values) override
+  {
+    // statm is "size resident shared ...", in pages
+    char buf[128] = {'\0'};
+    values[0] = 0;
+    if (statm >= 0 and pread(statm, buf, sizeof(buf) - 1, 0) > 0) {
+      char * resident;
+      std::strtoll(buf, &resident, 10);
+      values[0] = std::strtoll(resident, nullptr, 10) * pageSize;
+    }
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    values[1] = usage.ru_maxrss * 1024LL; // in kilobytes
+  }
+
+private:
+  int statm;
+  long long pageSize;
+};
+
+perf_event_attr makeAttr(unsigned int type, unsigned long long config)
+{
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.type = type;
+  attr.config = config;
+  return attr;
+}
+
+}
+
+std::unique_ptr<Probe> makePerfCounterProbe()
+{
+  std::unique_ptr<PerfCounterProbe> hardware(new PerfCounterProbe({
+        {"cycles", makeAttr(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES)},
+        {"instructions", makeAttr(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS)},
+        {"LLC-misses", makeAttr(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES)},
+        {"branch-misses", makeAttr(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES)}}));
+  if (hardware->isOpen())
+    return hardware;
+
+  std::unique_ptr<PerfCounterProbe> software(new PerfCounterProbe({
+        {"task-clock", makeAttr(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK)},
+        {"page-faults", makeAttr(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS)},
+        {"context-switches", makeAttr(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES)}}));
+  if (software->isOpen())
+    return software;
+
+  return std::unique_ptr<Probe>(new RUsageProbe);
+}
+
+
+std::unique_ptr<Probe> makeCPUTimeProbe()
+{
+  return std::unique_ptr<Probe>(new CPUTimeProbe);
+}
+
+
+std::unique_ptr<Probe> makeMemoryProbe()
+{
+  return std::unique_ptr<Probe>(new MemoryProbe);
+}
+
+}
@@ -0,0 +1,235 @@
+#include "EventTimings/EventUtils.hpp"
+#include "Lock.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <signal.h>
+#include <sstream>
+#include <sys/time.h>
+#include <ucontext.h>
+
+namespace EventTimings {
+
+namespace {
+
+/// Whether the signal handler records instruction pointers
+bool recordInstructionPointers = true;
+
+/// Samples, that hit a thread without running events
+std::atomic<long> samplesOutside{0};
+
+/// Samples, that did not fit into the ring of their thread
+std::atomic<long> samplesDropped{0};
+
+struct sigaction previousAction;
+
+bool sampling = false;
+
+/// Whether the sampler was started once, so buffers need a sample ring, guarded by the mutex of the registry
+bool sampleRings = false;
+
+/// Interval given to startSampling and the current one, as adjusted by the overhead budget controller
+std::chrono::microseconds requestedInterval, currentInterval;
+
+void setInterval(std::chrono::microseconds interval)
+{
+  itimerval timer;
+  timer.it_interval.tv_sec = interval.count() / 1000000;
+  timer.it_interval.tv_usec = interval.count() % 1000000;
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+/// Returns the instruction pointer of the interrupted context, 0 if unknown on this platform
+long long instructionPointer(void * context)
+{
+  auto const * uc = static_cast<ucontext_t const *>(context);
+#if defined(__linux__) && defined(__x86_64__)
+  return uc->uc_mcontext.gregs[REG_RIP];
+#elif defined(__linux__) && defined(__aarch64__)
+  return uc->uc_mcontext.pc;
+#else
+  (void) uc;
+  return 0;
+#endif
+}
+
+/// Appends a sample to the ring of the current thread, must be async-signal-safe.
+/** buffer is a pointer to thread-local storage, that was already accessed by the thread when it recorded
+its first event, so reading it does not allocate. */
+void handler(int, siginfo_t *, void * context)
+{
+  int const savedErrno = errno;
+  detail::Buffer * b = detail::buffer;
+  int const depth = b == nullptr ? 0 : b->depth;
+  long long * const ring = depth == 0 ? nullptr : b->samples.get();
+  if (depth == 0) {
+    samplesOutside.fetch_add(1, std::memory_order_relaxed);
+    errno = savedErrno;
+    return;
+  }
+
+  // Pairs with the fence in detail::enter, the ids below depth are written
+  std::atomic_signal_fence(std::memory_order_acquire);
+  unsigned const n = std::min(depth, detail::Buffer::maxDepth);
+  unsigned const head = b->sampleHead.load(std::memory_order_relaxed);
+  unsigned const tail = b->sampleTail.load(std::memory_order_acquire);
+  if (ring == nullptr or detail::Buffer::sampleCapacity - (head - tail) < n + 2) {
+    samplesDropped.fetch_add(1, std::memory_order_relaxed);
+    errno = savedErrno;
+    return;
+  }
+
+  auto const mask = detail::Buffer::sampleCapacity - 1;
+  ring[head & mask] = n;
+  ring[(head + 1) & mask] = recordInstructionPointers ? instructionPointer(context) : 0;
+  for (unsigned i = 0; i < n; ++i)
+    ring[(head + 2 + i) & mask] = b->running[i];
+  b->sampleHead.store(head + 2 + n, std::memory_order_release);
+  errno = savedErrno;
+}
+
+}
+
+void EventRegistry::startSampling(std::chrono::microseconds interval, bool instructionPointers)
+{
+  stopSampling();
+  if (not enabled)
+    return;
+  recordInstructionPointers = instructionPointers;
+  {
+    // The rings are allocated before the handler is installed, threads registering later get theirs in registerThread
+    Lock lock(mutex);
+    sampleRings = true;
+    for (auto & thread : threads)
+      addSampleRing(thread->buffer);
+  }
+
+  struct sigaction action;
+  action.sa_sigaction = handler;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, &previousAction);
+
+  // Measure the cost of delivering and handling a sample, then discard the samples
+  detail::Buffer * const b = detail::buffer;
+  unsigned const head = b ? b->sampleHead.load() : 0;
+  long const outside = samplesOutside.load(), dropped = samplesDropped.load();
+  int const signals = 100;
+  auto const start = std::chrono::steady_clock::now();
+  for (int i = 0; i < signals; ++i)
+    raise(SIGPROF);
+  sampleCost = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / signals;
+  if (b)
+    b->sampleHead.store(head);
+  samplesOutside.store(outside);
+  samplesDropped.store(dropped);
+
+  requestedInterval = currentInterval = interval;
+  setInterval(interval);
+  sampling = true;
+}
+
+std::chrono::microseconds EventRegistry::scaleSamplingInterval(double factor)
+{
+  if (not sampling)
+    return std::chrono::microseconds::zero();
+  std::chrono::microseconds const interval(std::min<long long>(
+    std::max<long long>(currentInterval.count() * factor, requestedInterval.count()),
+    std::max<long long>(requestedInterval.count(), 1000000)));
+  if (interval == currentInterval)
+    return std::chrono::microseconds::zero();
+  currentInterval = interval;
+  setInterval(interval);
+  return interval;
+}
+
+void EventRegistry::stopSampling()
+{
+  if (not sampling)
+    return;
+  itimerval timer = {};
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  sigaction(SIGPROF, &previousAction, nullptr);
+  sampling = false;
+}
+
+void EventRegistry::addSampleRing(detail::Buffer & buffer)
+{
+  if (sampleRings and not buffer.samples)
+    buffer.samples.reset(new long long[detail::Buffer::sampleCapacity]);
+}
+
+void EventRegistry::drainSamples(Thread & thread)
+{
+  auto & b = thread.buffer;
+  unsigned const head = b.sampleHead.load(std::memory_order_acquire);
+  unsigned tail = b.sampleTail.load(std::memory_order_relaxed);
+  auto const mask = detail::Buffer::sampleCapacity - 1;
+  int const namesSize = names.size();
+  long long const * const ring = b.samples.get(); // Not read without samples, head == tail
+
+  while (tail != head) {
+    unsigned const n = ring[tail & mask];
+    long long const ip = ring[(tail + 1) & mask];
+    int innermost = -1;
+    for (unsigned i = 0; i < n; ++i) {
+      int const id = ring[(tail + 2 + i) & mask];
+      if (id < 0 or id >= namesSize) // The sample interrupted a push of the running events
+        continue;
+      // Count recursive events once
+      bool outer = false;
+      for (unsigned j = 0; j < i; ++j)
+        outer = outer or ring[(tail + 2 + j) & mask] == id;
+      if (not outer)
+        getEventData(id).metrics["sample.total"] += 1;
+      innermost = id;
+    }
+    budgetSamples++;
+    if (innermost >= 0) {
+      auto & metrics = getEventData(innermost).metrics;
+      metrics["sample.self"] += 1;
+      if (ip != 0)
+        metrics["hotspot." + getSymbol(ip)] += 1;
+    }
+    tail += 2 + n;
+  }
+  b.sampleTail.store(tail, std::memory_order_release);
+
+  // Samples outside of events are accounted to _GLOBAL
+  long const outside = samplesOutside.exchange(0), dropped = samplesDropped.exchange(0);
+  if (outside or dropped) {
+    auto & metrics = getEventData(globalEvent.id).metrics;
+    metrics["sample.outside"] += outside;
+    metrics["sample.dropped"] += dropped;
+  }
+}
+
+std::string const & EventRegistry::getSymbol(long long ip)
+{
+  auto found = symbols.find(ip);
+  if (found != symbols.end())
+    return found->second;
+
+  std::string symbol = "unknown";
+  Dl_info info;
+  bool const loaded = dladdr(reinterpret_cast<void *>(ip), &info) != 0;
+  if (loaded and info.dli_sname) {
+    int status;
+    char * demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    symbol = status == 0 ? demangled : info.dli_sname;
+    std::free(demangled);
+  }
+  else if (loaded and info.dli_fname) { // Function not exported, e.g., static or in an executable linked without -rdynamic
+    std::string module = info.dli_fname;
+    std::ostringstream ss;
+    ss << module.substr(module.find_last_of('/') + 1) << "+0x" << std::hex
+       << ip - reinterpret_cast<long long>(info.dli_fbase);
+    symbol = ss.str();
+  }
+  return symbols.emplace(ip, symbol).first->second;
+}
+
+}
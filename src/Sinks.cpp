@@ -0,0 +1,294 @@
+#include "EventTimings/Sinks.hpp"
+#include "EventTimings/EventUtils.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+namespace EventTimings {
+
+namespace {
+
+class SummarySink : public Sink
+{
+public:
+  explicit SummarySink(std::ostream & out) : out(out) {}
+
+  void write(std::vector<RankData> const & ranks) override
+  {
+    EventRegistry::instance().writeSummary(out, ranks);
+  }
+
+private:
+  std::ostream & out;
+};
+
+class JSONSink : public Sink
+{
+public:
+  explicit JSONSink(std::string file) : file(std::move(file)) {}
+
+  void write(std::vector<RankData> const & ranks) override
+  {
+    std::ofstream out(file);
+    EventRegistry::instance().writeJSON(out, ranks);
+  }
+
+private:
+  std::string file;
+};
+
+class FoldedSink : public Sink
+{
+public:
+  explicit FoldedSink(std::string base) : base(std::move(base)) {}
+
+  void write(std::vector<RankData> const & ranks) override
+  {
+    std::ofstream merged(base + ".folded");
+    EventRegistry::instance().writeFolded(merged, ranks, true);
+    std::ofstream perRank(base + "-ranks.folded");
+    EventRegistry::instance().writeFolded(perRank, ranks, false);
+  }
+
+private:
+  std::string base;
+};
+
+class CommunicationSink : public Sink
+{
+public:
+  explicit CommunicationSink(std::string file) : file(std::move(file)) {}
+
+  void write(std::vector<RankData> const & ranks) override
+  {
+    bool hasTraffic = false;
+    for (auto const & rank : ranks)
+      for (auto const & ev : rank.evData)
+        hasTraffic = hasTraffic or not ev.second.sent.empty();
+    if (not hasTraffic)
+      return;
+    std::ofstream out(file);
+    EventRegistry::instance().writeCommunication(out, ranks);
+  }
+
+private:
+  std::string file;
+};
+
+class CounterSeriesSink : public Sink
+{
+public:
+  explicit CounterSeriesSink(std::string file) : file(std::move(file)) {}
+
+  void write(std::vector<RankData> const & ranks) override
+  {
+    bool hasCounters = false;
+    for (auto const & rank : ranks)
+      hasCounters = hasCounters or not rank.counters.empty();
+    if (not hasCounters)
+      return;
+    std::ofstream out(file, std::ios::binary);
+    EventRegistry::instance().writeCounterSeries(out, ranks);
+  }
+
+private:
+  std::string file;
+};
+
+class CSVSink : public Sink
+{
+public:
+  explicit CSVSink(std::string file) : file(std::move(file)) {}
+
+  void write(std::vector<RankData> const & ranks) override
+  {
+    std::ofstream out(file);
+    out << "rank,event,count,total,max,min,transitions\n";
+    for (size_t rank = 0; rank < ranks.size(); ++rank) {
+      for (auto const & ev : ranks[rank].evData) {
+        auto const & e = ev.second;
+        // Quote names, as they may contain commas
+        std::string name = e.getName();
+        for (size_t quote = name.find('"'); quote != std::string::npos; quote = name.find('"', quote + 2))
+          name.insert(quote, 1, '"');
+        out << rank << ",\"" << name << "\"," << e.getCount() << ',' << e.getTotal() << ','
+            << e.getMax() << ',' << e.getMin() << ',' << e.transitions << '\n';
+      }
+    }
+  }
+
+private:
+  std::string file;
+};
+
+class BinarySink : public Sink
+{
+public:
+  explicit BinarySink(std::string base) : base(std::move(base)) {}
+
+  void finalizeRank(int rank, RankData const & data) override
+  {
+    std::ofstream out(base + ".rank" + std::to_string(rank) + ".bin", std::ios::binary);
+    writeBinaryLog(out, data, rank);
+  }
+
+private:
+  std::string base;
+};
+
+class TraceSink : public Sink
+{
+public:
+  explicit TraceSink(std::string base) : base(std::move(base)) {}
+
+  bool isStreaming() const override { return true; }
+
+  void record(Run const & run) override
+  {
+    if (not spill.is_open()) {
+      spillFile = base + ".rank" + std::to_string(run.rank) + ".trace.part";
+      spill.open(spillFile, std::ios::binary);
+    }
+    auto const inserted = ids.emplace(run.name, static_cast<int>(names.size()));
+    if (inserted.second)
+      names.push_back(run.name);
+    Spilled const spilled{inserted.first->second, run.thread, run.start.count(), run.stop.count()};
+    spill.write(reinterpret_cast<char const *>(&spilled), sizeof(spilled));
+  }
+
+  void alignRank(int, Event::Clock::duration delay) override
+  {
+    this->delay = delay;
+  }
+
+  void finalizeRank(int rank, RankData const &) override
+  {
+    using micro = std::chrono::duration<double, std::micro>;
+    if (not spill.is_open())
+      return;
+    spill.close();
+
+    // The runs are spilled relative to the initialization of this rank, the trace is relative to the first rank
+    std::ifstream in(spillFile, std::ios::binary);
+    std::ofstream out(base + ".rank" + std::to_string(rank) + ".trace.json");
+    out << "[";
+    char const * separator = "\n";
+    Spilled run;
+    while (in.read(reinterpret_cast<char *>(&run), sizeof(run))) {
+      auto const start = Event::Clock::duration(run.start) + delay;
+      out << separator << R"({"name":")" << escape(names[run.name]) << R"(","ph":"X","pid":)" << rank
+          << R"(,"tid":)" << run.thread << R"(,"ts":)" << micro(start).count()
+          << R"(,"dur":)" << micro(Event::Clock::duration(run.stop - run.start)).count() << '}';
+      separator = ",\n";
+    }
+    out << "\n]\n";
+    in.close();
+    std::remove(spillFile.c_str());
+    ids.clear();
+    names.clear();
+    delay = Event::Clock::duration::zero();
+  }
+
+private:
+  /// Escapes quotes and backslashes for JSON strings and drops control characters
+  static std::string escape(std::string const & s)
+  {
+    std::string escaped;
+    for (char c : s) {
+      if (c == '"' or c == '\\')
+        escaped += '\\';
+      if (static_cast<unsigned char>(c) >= 0x20)
+        escaped += c;
+    }
+    return escaped;
+  }
+
+  /// A run as spilled, the name is an index into names
+  struct Spilled
+  {
+    std::int32_t name, thread;
+    Event::Clock::rep start, stop;
+  };
+
+  std::string base;
+
+  /// File of the spilled runs of this rank, removed when the trace is written
+  std::string spillFile;
+  std::ofstream spill;
+
+  /// Map of event name -> index in names
+  std::unordered_map<std::string, int> ids;
+  std::vector<std::string> names;
+
+  /// Time this rank initialized after the first rank, see alignRank
+  Event::Clock::duration delay = Event::Clock::duration::zero();
+};
+
+}
+
+std::unique_ptr<Sink> makeSink(std::string const & format, std::string const & base)
+{
+  if (format == "summary")
+    return makeSummarySink(std::cout);
+  if (format == "json")
+    return makeJSONSink(base + ".json");
+  if (format == "folded")
+    return makeFoldedSink(base);
+  if (format == "comm")
+    return makeCommunicationSink(base + ".comm");
+  if (format == "counters")
+    return makeCounterSeriesSink(base + ".counters");
+  if (format == "csv")
+    return makeCSVSink(base + ".csv");
+  if (format == "trace")
+    return makeTraceSink(base);
+  if (format == "bin")
+    return makeBinarySink(base);
+  return nullptr;
+}
+
+std::unique_ptr<Sink> makeSummarySink(std::ostream & out)
+{
+  return std::unique_ptr<Sink>(new SummarySink(out));
+}
+
+std::unique_ptr<Sink> makeJSONSink(std::string const & file)
+{
+  return std::unique_ptr<Sink>(new JSONSink(file));
+}
+
+std::unique_ptr<Sink> makeFoldedSink(std::string const & base)
+{
+  return std::unique_ptr<Sink>(new FoldedSink(base));
+}
+
+std::unique_ptr<Sink> makeCommunicationSink(std::string const & file)
+{
+  return std::unique_ptr<Sink>(new CommunicationSink(file));
+}
+
+std::unique_ptr<Sink> makeCounterSeriesSink(std::string const & file)
+{
+  return std::unique_ptr<Sink>(new CounterSeriesSink(file));
+}
+
+std::unique_ptr<Sink> makeCSVSink(std::string const & file)
+{
+  return std::unique_ptr<Sink>(new CSVSink(file));
+}
+
+std::unique_ptr<Sink> makeBinarySink(std::string const & base)
+{
+  return std::unique_ptr<Sink>(new BinarySink(base));
+}
+
+std::unique_ptr<Sink> makeTraceSink(std::string const & base)
+{
+  return std::unique_ptr<Sink>(new TraceSink(base));
+}
+
+}
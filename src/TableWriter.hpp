@@ -71,6 +71,18 @@ public:
     printRow(index+1, args...);
   }
 
+  /// Prints a line of a first entry followed by a variable number of values
+  template<class T, class V>
+  void printRowOf(T first, std::vector<V> const & values)
+  {
+    out << padding << std::setw(cols[0].width) << std::setprecision(cols[0].precision)
+        << first << padding << sepChar;
+    for (size_t i = 0; i < values.size(); ++i)
+      out << padding << std::setw(cols[i+1].width) << std::setprecision(cols[i+1].precision)
+          << values[i] << padding << sepChar;
+    out << std::endl;
+  }
+
   /// Recursion anchor, prints the last entry and the endl
   template<class T>
   void printRow(size_t index, T a)
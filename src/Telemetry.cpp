@@ -0,0 +1,94 @@
+#include "EventTimings/EventUtils.hpp"
+#include "Lock.hpp"
+#include "Telemetry.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace EventTimings {
+
+namespace {
+
+std::string segmentName()
+{
+  return std::string("/") + telemetry::prefix + std::to_string(getpid());
+}
+
+}
+
+void EventRegistry::openTelemetry()
+{
+  if (telemetry)
+    return;
+
+  std::string const name = segmentName();
+  int const fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd == -1) {
+    std::cerr << "EventTimings: Cannot create the telemetry segment " << name << ": " << std::strerror(errno) << std::endl;
+    return;
+  }
+  void * mapped = MAP_FAILED;
+  if (ftruncate(fd, sizeof(telemetry::Segment)) == 0)
+    mapped = mmap(nullptr, sizeof(telemetry::Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    std::cerr << "EventTimings: Cannot map the telemetry segment " << name << ": " << std::strerror(errno) << std::endl;
+    shm_unlink(name.c_str());
+    return;
+  }
+
+  telemetry = new (mapped) telemetry::Segment();
+  telemetry->version = telemetry::version;
+  telemetry->rank = commRank;
+  telemetry->pid = getpid();
+  telemetry::copyName(telemetry->application, applicationName.c_str());
+  telemetry->initialized = globalEvent.starttime.time_since_epoch().count();
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(telemetry->magic, telemetry::magic, sizeof(telemetry::magic));
+}
+
+void EventRegistry::publishTelemetry()
+{
+  lastTelemetry = Event::Clock::now();
+  if (not telemetry)
+    return;
+
+  auto const sequence = telemetry->sequence.load(std::memory_order_relaxed);
+  telemetry->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  std::uint32_t size = 0;
+  for (auto const & ev : localRankData.evData) {
+    if (size == telemetry::maxEvents)
+      break;
+    auto const & e = ev.second;
+    auto & entry = telemetry->entries[size++];
+    telemetry::copyName(entry.name, ev.first.c_str());
+    entry.count = e.getCount();
+    entry.total = e.total.count();
+    entry.max = e.getCount() ? e.max.count() : 0;
+    entry.min = e.getCount() ? e.min.count() : 0;
+    entry.transitions = e.transitions;
+  }
+  telemetry->size = size;
+  telemetry->updated = lastTelemetry.time_since_epoch().count();
+
+  telemetry->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void EventRegistry::closeTelemetry()
+{
+  if (not telemetry)
+    return;
+  munmap(telemetry, sizeof(telemetry::Segment));
+  shm_unlink(segmentName().c_str());
+  telemetry = nullptr;
+}
+
+}
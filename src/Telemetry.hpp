@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+namespace EventTimings {
+namespace telemetry {
+
+/// Shared-memory segments are named /eventtimings.<pid> and are found in /dev/shm
+constexpr char prefix[] = "eventtimings.";
+
+constexpr char magic[8] = "ETTELEM";
+constexpr std::uint32_t version = 1;
+
+/// Maximum number of events and length of names, longer names are truncated
+constexpr int maxEvents = 1024;
+constexpr int nameLength = 128;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "The sequence of the telemetry must be lock-free to be shared between processes");
+
+/// Statistics of an event, times in nanoseconds
+struct Entry
+{
+  char name[nameLength];
+  std::int64_t count, total, max, min, transitions;
+};
+
+/// Layout of the shared-memory segment of a rank.
+/** It has a single writer, the rank, and any number of readers, which must not block it.
+So the entries are guarded by a seqlock: The writer increments sequence to an odd value before and to an
+even value after writing. A reader copies the entries and retries, if sequence was odd or changed meanwhile. */
+struct Segment
+{
+  /// Set after the other fields of the header
+  char magic[8];
+  std::uint32_t version;
+  std::int32_t rank;
+  std::int64_t pid;
+  char application[nameLength];
+
+  std::atomic<std::uint64_t> sequence;
+
+  /// Steady clock in nanoseconds, when the rank initialized and when the entries were written last
+  std::int64_t initialized, updated;
+
+  /// Number of valid entries
+  std::uint32_t size;
+
+  Entry entries[maxEvents];
+};
+
+/// Copies a string into a fixed-size name, truncating and terminating it
+inline void copyName(char (&to)[nameLength], char const * from)
+{
+  std::strncpy(to, from, nameLength - 1);
+  to[nameLength - 1] = '\0';
+}
+
+}
+}
@@ -0,0 +1,189 @@
+// Microbenchmarks for the overhead of EventTimings itself.
+// Usage: benchevents [results.json]
+// Run on a single rank for the microbenchmarks, on multiple ranks only collect() is measured.
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <mpi.h>
+#include "EventTimings/EventUtils.hpp"
+#include "json.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace EventTimings;
+
+using Clock = std::chrono::steady_clock;
+using json = nlohmann::json;
+
+/// Reads the time stamp counter, falls back to nanoseconds on other architectures
+inline unsigned long long cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+#endif
+}
+
+/// Holds the results of all benchmarks
+json results = json::object();
+
+/// Runs op n times and stores the best of several runs per call of op
+template<class Op>
+void measure(std::string const & name, int n, Op op)
+{
+  double bestCycles = 1e100, bestNs = 1e100;
+  for (int rep = 0; rep < 5; ++rep) {
+    auto const start = Clock::now();
+    auto const startCycles = cycles();
+    for (int i = 0; i < n; ++i)
+      op(i);
+    auto const stopCycles = cycles();
+    std::chrono::duration<double, std::nano> const elapsed = Clock::now() - start;
+    bestCycles = std::min(bestCycles, static_cast<double>(stopCycles - startCycles) / n);
+    bestNs = std::min(bestNs, elapsed.count() / n);
+  }
+  results[name] = {{"Ops", n}, {"Cycles", bestCycles}, {"Nanoseconds", bestNs}};
+  std::cout << name << " = " << bestNs << " ns, " << bestCycles << " cycles" << std::endl;
+}
+
+/// Runs op once and stores its duration, setup is not measured
+template<class Setup, class Op>
+void measureOnce(std::string const & name, Setup setup, Op op)
+{
+  double best = 1e100;
+  for (int rep = 0; rep < 5; ++rep) {
+    setup();
+    auto const start = Clock::now();
+    op();
+    std::chrono::duration<double, std::nano> const elapsed = Clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  results[name] = {{"Ops", 1}, {"Nanoseconds", best}};
+  std::cout << name << " = " << best << " ns" << std::endl;
+}
+
+void benchEvents()
+{
+  int const n = 100000;
+
+  Event startStop("bench/startstop", false, false);
+  measure("Event/start+stop", n, [&](int) { startStop.start(); startStop.stop(); });
+
+  // The usual scoped use, that looks the name up on every construction
+  measure("Event/construct+start+stop+destruct", n, [](int) { Event scoped("bench/scoped"); });
+
+  Event pauseResume("bench/pauseresume");
+  measure("Event/pause+start", n, [&](int) { pauseResume.pause(); pauseResume.start(); });
+  pauseResume.stop();
+
+  Event withData("bench/data");
+  measure("Event/addData", n, [&](int i) { withData.addData("key", i); });
+  withData.stop();
+
+  measure("ScopedEventPrefix", n, [](int) { ScopedEventPrefix prefix("bench/"); });
+
+  EventRegistry::instance().getStoredEvent("bench/stored");
+  measure("EventRegistry/getStoredEvent", n, [](int) { EventRegistry::instance().getStoredEvent("bench/stored"); });
+}
+
+void benchRankData()
+{
+  for (int names : {10, 1000, 100000}) {
+    std::vector<std::unique_ptr<Event>> events;
+    for (int i = 0; i < names; ++i)
+      events.emplace_back(new Event("bench/put/" + std::to_string(i), false, false));
+
+    RankData rankData;
+    measure("RankData/put/" + std::to_string(names), 100000,
+            [&](int i) { rankData.put(*events[i % names]); });
+  }
+
+  RankData rankData;
+  measureOnce("RankData/normalizeTo/100x1000",
+              [&] {
+                rankData.clear();
+                rankData.initialize();
+                auto now = Clock::now();
+                for (int e = 0; e < 100; ++e) {
+                  Event::StateChanges stateChanges;
+                  for (int s = 0; s < 1000; ++s)
+                    stateChanges.emplace_back(Event::State::STARTED, now + std::chrono::microseconds(s));
+                  rankData.addEventData(EventData("bench/normalize/" + std::to_string(e), 1, 0, 0, 0,
+                                                  {}, stateChanges));
+                }
+              },
+              [&] { rankData.normalizeTo(rankData.initializedAt); });
+}
+
+/// Records events*instances state change pairs
+void recordEvents(int events, int instances)
+{
+  for (int e = 0; e < events; ++e) {
+    Event event("bench/collect/" + std::to_string(e), false, false);
+    for (int i = 0; i < instances; ++i) {
+      event.start();
+      event.stop();
+    }
+  }
+}
+
+void benchCollect(int size)
+{
+  auto & registry = EventRegistry::instance();
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  for (int events : {10, 100}) {
+    double best = 1e100;
+    for (int rep = 0; rep < 3; ++rep) {
+      registry.clear();
+      registry.initialize("benchevents");
+      recordEvents(events, 1000);
+      MPI_Barrier(MPI_COMM_WORLD);
+      auto const start = Clock::now();
+      registry.finalize(); // normalizes and collects
+      std::chrono::duration<double, std::nano> const elapsed = Clock::now() - start;
+      double local = elapsed.count(), slowest;
+      MPI_Allreduce(&local, &slowest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      best = std::min(best, slowest);
+    }
+    auto name = "EventRegistry/collect/" + std::to_string(events) + "x1000";
+    results[name] = {{"Ops", 1}, {"Nanoseconds", best}};
+    if (rank == 0)
+      std::cout << name << " = " << best << " ns on " << size << " ranks" << std::endl;
+
+    if (rank == 0) {
+      std::ostringstream out;
+      measureOnce("EventRegistry/writeJSON/" + std::to_string(events) + "x1000",
+                  [] {}, [&] { out.str(""); registry.writeJSON(out); });
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  std::string const resultsFile = argc > 1 ? argv[1] : "benchevents.json";
+
+  EventRegistry::instance().initialize("benchevents");
+  if (size == 1) {
+    benchEvents();
+    benchRankData();
+  }
+  EventRegistry::instance().finalize();
+  benchCollect(size);
+
+  if (rank == 0) {
+    std::ofstream out(resultsFile);
+    out << std::setw(2) << json{{"Ranks", size}, {"Benchmarks", results}} << std::endl;
+  }
+  MPI_Finalize();
+}
@@ -0,0 +1,97 @@
+// Compares a kernel instrumented with detail events to the plain kernel.
+// Usage: benchlevels [results.json]
+// Built once with the detail level enabled and once with it compiled out,
+// the latter should show no overhead at all, it fails otherwise.
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <type_traits>
+#include <mpi.h>
+#include "EventTimings/Levels.hpp"
+#include "json.hpp"
+
+using namespace EventTimings;
+
+using Clock = std::chrono::steady_clock;
+
+// Disabled events hold no state, so they can't cost anything at run time
+static_assert(isEnabled(Level::Detail) or std::is_empty<LeveledEvent<Level::Detail>>::value,
+              "Disabled events must be empty");
+
+/// Maximum ratio of the instrumented to the plain kernel, if the detail events are compiled out
+double const maxDisabledOverhead = 1.1;
+
+__attribute__((noinline)) double plainKernel(int n)
+{
+  double sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += 1.0 / (1.0 + i);
+  }
+  return sum;
+}
+
+__attribute__((noinline)) double instrumentedKernel(int n)
+{
+  double sum = 0;
+  for (int i = 0; i < n; ++i) {
+    LeveledEvent<Level::Detail> e("kernel/iteration");
+    EVENTTIMINGS_EVENT_DETAIL(m, "kernel/macro");
+    sum += 1.0 / (1.0 + i);
+    m.stop();
+  }
+  return sum;
+}
+
+/// Returns the duration of a run in nanoseconds per iteration
+template<class Kernel>
+double measure(Kernel kernel, int n, double & result)
+{
+  auto start = Clock::now();
+  result += kernel(n);
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+  return elapsed.count() / n;
+}
+
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  int const n = isEnabled(Level::Detail) ? 1000000 : 100000000;
+  double result = 0;
+  // The best of several runs, alternating, so both kernels see the same load of the machine
+  double plain = 1e100, instrumented = 1e100;
+  for (int rep = 0; rep < 7; ++rep) {
+    plain = std::min(plain, measure(plainKernel, n, result));
+    instrumented = std::min(instrumented, measure(instrumentedKernel, n, result));
+  }
+  double const overhead = instrumented / plain;
+
+  std::cout << "Level          = " << EVENTTIMINGS_LEVEL << std::endl
+            << "Detail enabled = " << isEnabled(Level::Detail) << std::endl
+            << "Plain          = " << plain << " ns/iteration" << std::endl
+            << "Instrumented   = " << instrumented << " ns/iteration" << std::endl
+            << "Overhead       = " << overhead << "x" << std::endl
+            << "(Result " << result << ")" << std::endl;
+
+  if (argc > 1) {
+    nlohmann::json const results = {
+      {"Level", EVENTTIMINGS_LEVEL},
+      {"DetailEnabled", isEnabled(Level::Detail)},
+      {"Iterations", n},
+      {"Plain", {{"Nanoseconds", plain}}},
+      {"Instrumented", {{"Nanoseconds", instrumented}}},
+      {"Overhead", overhead}
+    };
+    std::ofstream out(argv[1]);
+    out << std::setw(2) << results << std::endl;
+  }
+
+  bool const failed = not isEnabled(Level::Detail) and overhead > maxDisabledOverhead;
+  if (failed)
+    std::cerr << "Compiled out events cost " << (overhead - 1) * 100 << "% of the plain kernel" << std::endl;
+
+  MPI_Finalize();
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,40 @@
+// Merges the binary event logs of the ranks, e.g. written with EVENTTIMINGS_COLLECT=0, into the outputs of printAll.
+// Usage: et-merge [-j threads] app-events.rank0.bin app-events.rank1.bin ...
+// The outputs are configured by the EVENTTIMINGS_* variables, e.g. EVENTTIMINGS_OUTPUT_DIR, as in the application.
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <mpi.h>
+#include "EventTimings/EventUtils.hpp"
+
+using namespace EventTimings;
+
+int main(int argc, char *argv[])
+{
+  unsigned threads = 0;
+  int option;
+  while ((option = getopt(argc, argv, "j:")) != -1) {
+    if (option != 'j') {
+      std::cerr << "Usage: et-merge [-j threads] <binary event logs>..." << std::endl;
+      return 1;
+    }
+    threads = std::atoi(optarg);
+  }
+  if (optind == argc) {
+    std::cerr << "Usage: et-merge [-j threads] <binary event logs>..." << std::endl;
+    return 1;
+  }
+
+  MPI_Init(&argc, &argv);
+  auto & registry = EventRegistry::instance();
+  bool const merged = registry.readBinaryLogs(std::vector<std::string>(argv + optind, argv + argc), threads);
+  if (merged) {
+    registry.collectRanks = true; // The outputs need the data of all ranks, even if configured otherwise
+    registry.formats.erase("bin");
+    registry.printAll();
+  }
+  MPI_Finalize();
+  return merged ? 0 : 1;
+}
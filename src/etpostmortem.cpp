@@ -0,0 +1,25 @@
+// Merges the crash dumps of EventRegistry::signal_handler into the outputs of printAll.
+// Usage: et-postmortem app-events.rank0.crash app-events.rank1.crash ...
+// The outputs are configured by the EVENTTIMINGS_* variables, e.g. EVENTTIMINGS_OUTPUT_DIR, as in the application.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mpi.h>
+#include "EventTimings/EventUtils.hpp"
+
+using namespace EventTimings;
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2) {
+    std::cerr << "Usage: et-postmortem <crash dumps>..." << std::endl;
+    return 1;
+  }
+  MPI_Init(&argc, &argv);
+  auto & registry = EventRegistry::instance();
+  bool const merged = registry.readCrashDumps(std::vector<std::string>(argv + 1, argv + argc));
+  if (merged)
+    registry.printAll();
+  MPI_Finalize();
+  return merged ? 0 : 1;
+}
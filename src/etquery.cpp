@@ -0,0 +1,99 @@
+// Prints the intervals, in which events ran within a time range, from binary event logs, see EVENTTIMINGS_COLLECT.
+// Usage: et-query [-r rank] [-e event] [-f from] [-t to] log...
+// Times are in seconds since the first rank of the logs initialized, as in the outputs of printAll.
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "EventTimings/LogReader.hpp"
+
+using namespace EventTimings;
+
+namespace {
+
+void usage()
+{
+  std::cerr << "Usage: et-query [-r rank] [-e event] [-f from] [-t to] log...\n"
+            << "  -r  Only intervals of this rank, default all ranks\n"
+            << "  -e  Only intervals of this event, default all events\n"
+            << "  -f  Begin of the time range in seconds, default the first interval\n"
+            << "  -t  End of the time range in seconds, default the last interval\n";
+}
+
+/// Converts seconds since t0 to ticks of a rank, clamped to the range of ticks
+std::int64_t toTicks(double seconds, binary::Header const & h, std::int64_t t0)
+{
+  double const ticks = seconds * 1e9 - (h.initializedAt - t0) + h.initializedAtTicks;
+  if (ticks <= std::numeric_limits<std::int64_t>::min())
+    return std::numeric_limits<std::int64_t>::min();
+  if (ticks >= std::numeric_limits<std::int64_t>::max())
+    return std::numeric_limits<std::int64_t>::max();
+  return ticks;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+  bool allRanks = true;
+  int rank = 0;
+  std::string event;
+  double from = -std::numeric_limits<double>::infinity(), to = std::numeric_limits<double>::infinity();
+  int option;
+  while ((option = getopt(argc, argv, "r:e:f:t:h")) != -1) {
+    switch (option) {
+    case 'r': allRanks = false; rank = std::atoi(optarg); break;
+    case 'e': event = optarg; break;
+    case 'f': from = std::atof(optarg); break;
+    case 't': to = std::atof(optarg); break;
+    default: usage(); return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (optind == argc) {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  std::vector<binary::Log> logs;
+  for (int i = optind; i < argc; ++i) {
+    logs.emplace_back();
+    if (not logs.back().open(argv[i])) {
+      std::cerr << "et-query: " << logs.back().getError() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Times are normalized to the rank, that initialized first, as RankData::normalizeTo does
+  auto t0 = std::numeric_limits<std::int64_t>::max();
+  for (auto const & log : logs)
+    for (auto const & block : log)
+      t0 = std::min(t0, block.header().initializedAt);
+
+  std::cout << "# Rank\tEvent\tStart [s]\tStop [s]\n" << std::fixed << std::setprecision(9);
+  for (auto const & log : logs) {
+    for (auto const & block : log) {
+      if (not allRanks and block.rank() != rank)
+        continue;
+      auto const & h = block.header();
+      auto const begin = toTicks(from, h, t0), end = toTicks(to, h, t0);
+      std::vector<binary::Interval const *> intervals;
+      if (event.empty())
+        intervals = block.intervals(begin, end);
+      else if (auto e = block.event(event))
+        intervals = block.intervals(*e, begin, end);
+
+      auto const offset = h.initializedAt - t0 - h.initializedAtTicks;
+      for (auto interval : intervals) {
+        auto const e = block.event(*interval);
+        std::cout << block.rank() << '\t' << (e ? block.string(e->name) : binary::StringView()) << '\t'
+                  << (interval->start + offset) * 1e-9 << '\t' << (interval->stop + offset) * 1e-9 << '\n';
+      }
+    }
+  }
+  return EXIT_SUCCESS;
+}
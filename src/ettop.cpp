@@ -0,0 +1,216 @@
+// Shows the statistics, that running applications publish to shared memory, see EVENTTIMINGS_TELEMETRY_INTERVAL.
+// Usage: et-top [-d seconds] [-n iterations] [-a application]
+// Only reads the segments of the ranks on this node, it neither stops the application nor communicates by MPI.
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <map>
+#include <signal.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "Telemetry.hpp"
+#include "TableWriter.hpp"
+
+using namespace EventTimings;
+
+namespace {
+
+/// Consistent copy of the segment of a rank
+struct Snapshot
+{
+  int rank;
+  long pid;
+  std::string application;
+  std::int64_t updated;
+  std::vector<telemetry::Entry> entries;
+};
+
+/// Rates of an event of a rank, between the last two updates of its segment
+struct Rate
+{
+  double count, busy;
+};
+
+/// Statistics of an event over all ranks
+struct Row
+{
+  int ranks = 0;
+  long count = 0;
+  double total = 0, max = 0, rate = 0, busy = 0;
+};
+
+/// Copies a segment, returns false if it is invalid, does not become consistent or its process is gone
+bool read(std::string const & name, Snapshot & snapshot)
+{
+  int const fd = shm_open(("/" + name).c_str(), O_RDONLY, 0);
+  if (fd == -1)
+    return false;
+  struct stat st;
+  void * mapped = MAP_FAILED;
+  if (fstat(fd, &st) == 0 and st.st_size == sizeof(telemetry::Segment))
+    mapped = mmap(nullptr, sizeof(telemetry::Segment), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED)
+    return false;
+
+  auto const & segment = *static_cast<telemetry::Segment const *>(mapped);
+  bool consistent = false;
+  if (std::memcmp(segment.magic, telemetry::magic, sizeof(telemetry::magic)) == 0
+      and segment.version == telemetry::version) {
+    snapshot.rank = segment.rank;
+    snapshot.pid = segment.pid;
+    snapshot.application.assign(segment.application, strnlen(segment.application, telemetry::nameLength));
+    // A writer, that died while writing, leaves the sequence odd
+    for (int attempt = 0; attempt < 1000 and not consistent; ++attempt) {
+      auto const sequence = segment.sequence.load(std::memory_order_acquire);
+      if (sequence % 2 == 0) {
+        snapshot.updated = segment.updated;
+        auto const size = std::min<std::uint32_t>(segment.size, telemetry::maxEvents);
+        snapshot.entries.assign(segment.entries, segment.entries + size);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        consistent = segment.sequence.load(std::memory_order_relaxed) == sequence;
+      }
+      if (not consistent)
+        std::this_thread::yield();
+    }
+  }
+  munmap(mapped, sizeof(telemetry::Segment));
+
+  // Segments of killed processes are never removed
+  return consistent and (kill(snapshot.pid, 0) == 0 or errno == EPERM);
+}
+
+/// Reads the segments in /dev/shm, optionally only of an application
+std::map<std::string, Snapshot> readAll(std::string const & application)
+{
+  std::map<std::string, Snapshot> snapshots;
+  DIR * dir = opendir("/dev/shm");
+  if (not dir)
+    return snapshots;
+  while (dirent * entry = readdir(dir)) {
+    std::string const name = entry->d_name;
+    Snapshot snapshot;
+    if (name.compare(0, std::strlen(telemetry::prefix), telemetry::prefix) == 0 and read(name, snapshot)
+        and (application.empty() or snapshot.application == application))
+      snapshots[name] = std::move(snapshot);
+  }
+  closedir(dir);
+  return snapshots;
+}
+
+void usage()
+{
+  std::cerr << "Usage: et-top [-d seconds] [-n iterations] [-a application]\n"
+            << "  -d  Delay between updates, default 2 seconds\n"
+            << "  -n  Number of updates, default 0 runs until interrupted\n"
+            << "  -a  Show only ranks of this application\n";
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+  double delay = 2;
+  long iterations = 0;
+  std::string application;
+  int option;
+  while ((option = getopt(argc, argv, "d:n:a:h")) != -1) {
+    switch (option) {
+    case 'd': delay = std::atof(optarg); break;
+    case 'n': iterations = std::atol(optarg); break;
+    case 'a': application = optarg; break;
+    default: usage(); return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+
+  bool const terminal = isatty(STDOUT_FILENO);
+  std::map<std::string, Snapshot> previous;
+  std::map<std::pair<std::string, std::string>, Rate> rates; // (segment, event) -> rate
+
+  for (long iteration = 0; iterations == 0 or iteration < iterations; ++iteration) {
+    if (iteration > 0)
+      std::this_thread::sleep_for(std::chrono::duration<double>(delay));
+
+    auto current = readAll(application);
+    std::map<std::pair<std::string, std::string>, Rate> currentRates;
+    for (auto const & segment : current) {
+      auto const old = previous.find(segment.first);
+      if (old == previous.end() or old->second.updated == segment.second.updated) {
+        // Keep the rates until the rank publishes again
+        for (auto const & rate : rates)
+          if (rate.first.first == segment.first)
+            currentRates.insert(rate);
+        continue;
+      }
+      double const seconds = (segment.second.updated - old->second.updated) * 1e-9;
+      std::map<std::string, telemetry::Entry const *> before;
+      for (auto const & e : old->second.entries)
+        before[e.name] = &e;
+      for (auto const & e : segment.second.entries) {
+        auto const b = before.find(e.name);
+        double const count = e.count - (b == before.end() ? 0 : b->second->count);
+        double const total = e.total - (b == before.end() ? 0 : b->second->total);
+        currentRates[{segment.first, e.name}] = {count / seconds, total * 1e-9 / seconds};
+      }
+    }
+    rates = std::move(currentRates);
+    previous = current;
+
+    std::map<std::string, Row> rows;
+    double oldest = 0;
+    auto const now = std::chrono::steady_clock::now().time_since_epoch().count();
+    for (auto const & segment : current) {
+      oldest = std::max(oldest, (now - segment.second.updated) * 1e-9);
+      for (auto const & e : segment.second.entries) {
+        auto & row = rows[e.name];
+        row.ranks++;
+        row.count += e.count;
+        row.total += e.total * 1e-6;
+        row.max = std::max(row.max, e.max * 1e-6);
+        auto const rate = rates.find({segment.first, e.name});
+        if (rate != rates.end()) {
+          row.rate += rate->second.count;
+          row.busy += rate->second.busy;
+        }
+      }
+    }
+    std::vector<std::pair<std::string, Row>> sorted(rows.begin(), rows.end());
+    std::stable_sort(sorted.begin(), sorted.end(), [](std::pair<std::string, Row> const & a,
+                                                      std::pair<std::string, Row> const & b) {
+      return a.second.busy > b.second.busy;
+    });
+
+    if (terminal)
+      std::cout << "\033[H\033[2J";
+    if (current.empty()) {
+      std::cout << "No ranks publish telemetry on this node, set EVENTTIMINGS_TELEMETRY_INTERVAL." << std::endl;
+      continue;
+    }
+    std::cout << "EventTimings: " << current.size() << " ranks on this node, oldest update "
+              << oldest << " s ago" << std::endl << std::endl;
+
+    Table table;
+    table.addColumn("Event", 30);
+    table.addColumn("Ranks", 5);
+    table.addColumn("Count", 10);
+    table.addColumn("Count/s", 12, 6);
+    table.addColumn("Total [ms]", 12, 6);
+    table.addColumn("Max [ms]", 10, 6);
+    table.addColumn("Busy [%]", 8, 3);
+    table.printHeader();
+    for (auto const & row : sorted) {
+      auto const & r = row.second;
+      table.printRow(row.first, r.ranks, r.count, r.rate, r.total, r.max, 100 * r.busy / r.ranks);
+    }
+    std::cout << std::flush;
+  }
+}
@@ -0,0 +1,219 @@
+// Writes the data of two ranks as binary event log, reads it back and compares it to the written data.
+// The log is kept as testbinarylog.bin, so et-merge can be tested on it.
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "EventTimings/EventUtils.hpp"
+#include "EventTimings/LogReader.hpp"
+
+using namespace EventTimings;
+using std::chrono::nanoseconds;
+
+int failures = 0;
+
+void check(bool condition, std::string const & what)
+{
+  if (not condition) {
+    std::cerr << "Failed: " << what << std::endl;
+    failures++;
+  }
+}
+
+/// Returns the data of a rank with events, data, metrics, traffic, a call tree, counters and decisions
+RankData makeRank(int rank)
+{
+  auto const initializedAt = std::chrono::system_clock::time_point(std::chrono::seconds(1600000000 + rank));
+  Event::Clock::time_point const ticks(std::chrono::seconds(1000 + 10 * rank));
+  auto const at = [&](long ms) { return ticks + std::chrono::milliseconds(ms); };
+
+  RankData data;
+  data.initialize(initializedAt, ticks);
+  data.transitionCost = 40.5 + rank;
+  data.compensated = rank == 1;
+
+  EventData solve("solve", 2, 0, 0, 0, {{"iterations", {10, 12 + rank}}},
+                  {{Event::State::STARTED, at(1)}, {Event::State::STOPPED, at(5)},
+                   {Event::State::STARTED, at(7)}, {Event::State::PAUSED, at(8)},
+                   {Event::State::STARTED, at(9)}, {Event::State::STOPPED, at(12)}});
+  solve.stateChangeThreads = {0, 0, 1, 1, 0, 0};
+  solve.total = nanoseconds(8000000);
+  solve.max = nanoseconds(5000000);
+  solve.min = nanoseconds(3000000);
+  solve.transitions = 6;
+  solve.untraced = 3;
+  solve.metrics["mpi.time"] = 1234.5;
+  solve.metrics["mpi.Allreduce.calls"] = 17;
+  solve.sent[1 - rank].bytes = 4096;
+  solve.sent[1 - rank].messages = 4;
+  data.addEventData(solve);
+
+  // Started, but not stopped, so its interval ends at finalize
+  EventData io("solve/io, \"quoted\"", 1, 0, 0, 0, {}, {{Event::State::STARTED, at(2)}});
+  io.total = nanoseconds(500);
+  io.max = io.min = io.total;
+  io.transitions = 1;
+  io.throttled = true;
+  data.addEventData(io);
+
+  auto & tree = data.callTree;
+  int const node = tree.child(0, "solve");
+  tree.nodes[node].count = 2;
+  tree.nodes[node].inclusive = nanoseconds(8000000);
+  tree.nodes[node].transitions = 6;
+  int const child = tree.child(node, "solve/io, \"quoted\"");
+  tree.nodes[child].count = 1;
+  tree.nodes[child].inclusive = nanoseconds(500);
+
+  auto & residual = data.counters["residual"];
+  residual.timestamps = {at(3).time_since_epoch().count(), at(4).time_since_epoch().count()};
+  residual.values = {1e-3, 1e-6 * (rank + 1)};
+
+  data.decisions.push_back({0.5, 0.02, "shed", "solve/io"});
+  data.finalize(initializedAt + std::chrono::milliseconds(20), at(20));
+  return data;
+}
+
+/// Compares the data read from the log to the written data
+void compare(RankData const & read, RankData const & written, int rank)
+{
+  std::string const r = "rank " + std::to_string(rank) + ": ";
+  check(read.initializedAt == written.initializedAt, r + "initializedAt");
+  check(read.finalizedAt == written.finalizedAt, r + "finalizedAt");
+  check(read.getInitializedAtTicks() == written.getInitializedAtTicks(), r + "initializedAtTicks");
+  check(read.transitionCost == written.transitionCost, r + "transitionCost");
+  check(read.compensated == written.compensated, r + "compensated");
+
+  check(read.evData.size() == written.evData.size(), r + "number of events");
+  for (auto const & w : written.evData) {
+    auto found = read.evData.find(w.first);
+    if (found == read.evData.end()) {
+      check(false, r + "event " + w.first);
+      continue;
+    }
+    auto const & e = found->second;
+    std::string const ev = r + w.first + ": ";
+    check(e.getCount() == w.second.getCount(), ev + "count");
+    check(e.total == w.second.total and e.max == w.second.max and e.min == w.second.min, ev + "times");
+    check(e.transitions == w.second.transitions, ev + "transitions");
+    check(e.untraced == w.second.untraced, ev + "untraced");
+    check(e.throttled == w.second.throttled, ev + "throttled");
+    check(e.stateChanges == w.second.stateChanges, ev + "state changes");
+    // Unknown threads are written as thread 0
+    auto threads = w.second.stateChangeThreads;
+    threads.resize(w.second.stateChanges.size(), 0);
+    check(e.stateChangeThreads == threads, ev + "threads of the state changes");
+    check(e.getData() == w.second.getData(), ev + "data");
+    check(e.metrics == w.second.metrics, ev + "metrics");
+    check(e.sent.size() == w.second.sent.size(), ev + "sent");
+    for (auto const & s : w.second.sent) {
+      auto peer = e.sent.find(s.first);
+      check(peer != e.sent.end() and peer->second.bytes == s.second.bytes
+            and peer->second.messages == s.second.messages, ev + "traffic to " + std::to_string(s.first));
+    }
+  }
+
+  check(read.callTree.nodes.size() == written.callTree.nodes.size(), r + "number of nodes");
+  for (size_t n = 0; n < std::min(read.callTree.nodes.size(), written.callTree.nodes.size()); ++n) {
+    auto const & a = read.callTree.nodes[n];
+    auto const & b = written.callTree.nodes[n];
+    check(a.name == b.name and a.parent == b.parent and a.count == b.count and a.inclusive == b.inclusive
+          and a.transitions == b.transitions, r + "node " + std::to_string(n));
+  }
+
+  check(read.counters.size() == written.counters.size(), r + "number of counters");
+  for (auto const & c : written.counters) {
+    auto found = read.counters.find(c.first);
+    check(found != read.counters.end() and found->second.timestamps == c.second.timestamps
+          and found->second.values == c.second.values, r + "counter " + c.first);
+  }
+
+  check(read.decisions.size() == written.decisions.size(), r + "number of decisions");
+  for (size_t d = 0; d < std::min(read.decisions.size(), written.decisions.size()); ++d) {
+    auto const & a = read.decisions[d];
+    auto const & b = written.decisions[d];
+    check(a.time == b.time and a.overhead == b.overhead and a.action == b.action and a.subject == b.subject,
+          r + "decision " + std::to_string(d));
+  }
+}
+
+int main()
+{
+  std::string const file = "testbinarylog.bin";
+  std::vector<RankData> written{makeRank(0), makeRank(1)};
+  {
+    // Blocks are self-contained, so the files of the ranks can be concatenated
+    std::ofstream out(file, std::ios::binary);
+    for (size_t rank = 0; rank < written.size(); ++rank)
+      writeBinaryLog(out, written[rank], rank);
+  }
+
+  std::vector<std::pair<int, RankData>> read;
+  check(readBinaryLog(file, read), "readBinaryLog");
+  check(read.size() == written.size(), "number of ranks");
+  for (size_t i = 0; i < std::min(read.size(), written.size()); ++i) {
+    check(read[i].first == static_cast<int>(i), "rank of block " + std::to_string(i));
+    compare(read[i].second, written[i], i);
+  }
+
+  // The reader in place
+  binary::Log log(file);
+  check(log.isOpen(), "open: " + log.getError());
+  auto const block = log.rank(1);
+  check(block != nullptr, "block of rank 1");
+  if (block) {
+    check(block->event("missing") == nullptr, "lookup of a missing event");
+    auto const event = block->event("solve");
+    check(event != nullptr and block->string(event->name) == "solve", "lookup of an event by name");
+    check(event != nullptr and block->stateChanges(*event).size() == 6, "state changes of an event");
+    if (event) {
+      // Start to stop, start to pause, resume to stop
+      auto const intervals = block->intervals(*event);
+      check(intervals.size() == 3, "number of intervals");
+      auto const first = written[1].getInitializedAtTicks().time_since_epoch().count();
+      std::vector<std::pair<long, long>> expected{{1, 5}, {7, 8}, {9, 12}};
+      for (size_t i = 0; i < std::min<size_t>(intervals.size(), expected.size()); ++i)
+        check(intervals[i].start == first + expected[i].first * 1000000
+              and intervals[i].stop == first + expected[i].second * 1000000, "interval " + std::to_string(i));
+    }
+    // Unfinished runs end at finalize
+    auto const io = block->event("solve/io, \"quoted\"");
+    check(io != nullptr and block->intervals(*io).size() == 1
+          and block->intervals(*io)[0].stop == (written[1].getInitializedAtTicks()
+                                                + std::chrono::milliseconds(20)).time_since_epoch().count(),
+          "interval of an unfinished run");
+  }
+
+  // Invalid logs are rejected: no log, an empty file, a truncated block and a section outside its block
+  std::string valid;
+  {
+    std::ifstream in(file, std::ios::binary);
+    valid.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  binary::Header header;
+  std::memcpy(&header, valid.data(), sizeof(header));
+  header.events.size = header.blockSize;
+  std::string outside = valid;
+  std::memcpy(&outside[0], &header, sizeof(header));
+  std::vector<std::pair<std::string, std::string>> const invalid{
+    {std::string(sizeof(header), 'x'), "No binary event log"},
+    {"", "empty"},
+    {valid.substr(0, valid.size() - 8), "truncated"},
+    {outside, "Section exceeds the block"}};
+  for (auto const & i : invalid) {
+    {
+      std::ofstream out("testbinarylog.invalid.bin", std::ios::binary);
+      out << i.first;
+    }
+    binary::Log log;
+    check(not log.open("testbinarylog.invalid.bin") and not log.isOpen()
+          and log.getError().find(i.second) != std::string::npos, "rejection of an invalid log: " + i.second);
+  }
+
+  if (failures == 0)
+    std::cout << "Binary log round trip passed" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
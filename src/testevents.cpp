@@ -1,13 +1,50 @@
 #include <thread>
 #include <iostream>
+#include <sstream>
 #include <random>
 #include <mpi.h>
 #include "EventTimings/EventUtils.hpp"
+#include "EventTimings/Levels.hpp"
 
 using std::cout;
 using std::endl;
 using namespace EventTimings;
 
+int failures = 0;
+
+void check(bool condition, std::string const & what)
+{
+  if (not condition) {
+    std::cerr << "Failed: " << what << std::endl;
+    failures++;
+  }
+}
+
+/// Keeps the data of all ranks, as passed by printAll, so the results can be checked
+class ResultSink : public Sink
+{
+public:
+  explicit ResultSink(std::vector<RankData> & ranks) : ranks(ranks) {}
+
+  void write(std::vector<RankData> const & data) override { ranks = data; }
+
+private:
+  std::vector<RankData> & ranks;
+};
+
+/// Returns the node of a call path, e.g. {"a", "b"} for b called in a, -1 if there is none
+int findNode(CallTree const & tree, std::vector<std::string> const & path)
+{
+  int node = 0;
+  for (auto const & name : path) {
+    auto found = tree.nodes[node].children.find(name);
+    if (found == tree.nodes[node].children.end())
+      return -1;
+    node = found->second;
+  }
+  return node;
+}
+
 
 double rand(double min, double max) {
   std::random_device rd;
@@ -20,6 +57,14 @@ void sleep(int ms) {
   std::this_thread::sleep_for(std::chrono::milliseconds(ms));
 }
 
+/// Keeps the CPU busy, unlike sleep, so it is sampled
+void compute(int ms) {
+  auto const end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+  volatile double x = 0;
+  while (std::chrono::steady_clock::now() < end)
+    x = x + 1;
+}
+
 void solve() {
   Event e("solve");
   sleep(rand(0.6, 1.4) * 8000.0);
@@ -83,6 +128,214 @@ void testevents() {
   
 }
 
+void testnesting() {
+  Event outer("outer");
+  auto & residual = EventRegistry::instance().counter("residual");
+  for (int i = 0; i < 3; ++i) {
+    Event inner("inner");
+    residual.record(1.0 / (i + 1));
+    LeveledEvent<Level::Detail> detail("inner/detail");
+    sleep(10);
+    detail.stop();
+    int value = i, sum; // Recorded as MPI call of inner, as testevents compiles in PMPI.cpp
+    MPI_Allreduce(&value, &sum, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    inner.stop();
+    Event("inner/given", std::chrono::milliseconds(1));
+  }
+  Event busy("outer/compute");
+  compute(20);
+  std::vector<double> values(1 << 20); // Counted, if EventTimingsMalloc is linked
+  busy.stop();
+
+  Event io("outer/io"); // Counted as I/O, as testevents compiles in PMPI.cpp
+  MPI_File file;
+  MPI_File_open(MPI_COMM_SELF, "testevents.tmp", MPI_MODE_CREATE | MPI_MODE_WRONLY | MPI_MODE_DELETE_ON_CLOSE,
+                MPI_INFO_NULL, &file);
+  MPI_File_write(file, values.data(), 1024, MPI_DOUBLE, MPI_STATUS_IGNORE);
+  MPI_File_close(&file);
+  io.stop();
+
+  // Ring exchange, shows up in the communication matrix of outer
+  int rank, size, received;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  MPI_Sendrecv(&rank, 1, MPI_INT, (rank + 1) % size, 0, &received, 1, MPI_INT, (rank + size - 1) % size, 0,
+               MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+  sleep(10);
+
+  // Higher ranks arrive later at the barrier in stop, so rank 0 waits most
+  Event synced("synced", true);
+  sleep(5 * rank);
+}
+
+/// Nests events of given durations into a running event, so the replayed call tree is known
+void testcalltree() {
+  Event outer("tree/outer");
+  for (int i = 0; i < 2; ++i)
+    Event("tree/a", std::chrono::milliseconds(3));
+  Event("tree/b", std::chrono::milliseconds(5));
+  sleep(20); // outer runs longer than its children
+}
+
+void checkcalltree(RankData const & data) {
+  using std::chrono::milliseconds;
+  auto const & tree = data.callTree;
+  int const outer = findNode(tree, {"_GLOBAL", "tree/outer"}), a = findNode(tree, {"_GLOBAL", "tree/outer", "tree/a"}),
+            b = findNode(tree, {"_GLOBAL", "tree/outer", "tree/b"});
+  check(outer > 0 and a > 0 and b > 0, "call tree has the nested paths");
+  if (outer <= 0 or a <= 0 or b <= 0)
+    return;
+  check(tree.nodes[outer].count == 1 and tree.nodes[a].count == 2 and tree.nodes[b].count == 1, "call tree counts");
+  check(tree.nodes[a].inclusive == milliseconds(6) and tree.nodes[b].inclusive == milliseconds(5),
+        "inclusive time of given events");
+  check(tree.nodes[outer].inclusive >= milliseconds(11), "inclusive time contains the children");
+  check(tree.getExclusive(outer) == tree.nodes[outer].inclusive - milliseconds(11), "exclusive time of outer");
+  check(tree.getExclusive(a) == milliseconds(6), "exclusive time of a leaf");
+  check(data.evData.at("tree/a").total == milliseconds(6), "total of tree/a");
+
+  // Merging sums up the nodes of equal paths
+  CallTree merged;
+  merged.merge(tree);
+  merged.merge(tree);
+  int const mergedOuter = findNode(merged, {"_GLOBAL", "tree/outer"});
+  check(merged.nodes[findNode(merged, {"_GLOBAL", "tree/outer", "tree/a"})].count == 4, "merged count");
+  check(merged.getExclusive(mergedOuter) == 2 * tree.getExclusive(outer), "merged exclusive time");
+}
+
+/// Returns whether out has the given line
+bool hasLine(std::string const & out, std::string const & line)
+{
+  std::istringstream lines(out);
+  std::string l;
+  while (std::getline(lines, l))
+    if (l == line)
+      return true;
+  return false;
+}
+
+void checkfolded(std::vector<RankData> const & ranks) {
+  std::ostringstream merged, perRank;
+  EventRegistry::instance().writeFolded(merged);
+  EventRegistry::instance().writeFolded(perRank, ranks, false);
+  // The merged paths are summed up over all ranks
+  check(hasLine(merged.str(), "_GLOBAL;tree/outer;tree/a " + std::to_string(ranks.size() * 6000000)),
+        "folded line of tree/a");
+  check(hasLine(merged.str(), "_GLOBAL;tree/outer;tree/b " + std::to_string(ranks.size() * 5000000)),
+        "folded line of tree/b");
+  check(hasLine(perRank.str(), "rank 0;_GLOBAL;tree/outer;tree/a 6000000"), "folded line of rank 0");
+
+  // Separators in names are replaced, paths without exclusive time are omitted
+  CallTree tree;
+  int const a = tree.child(0, "a;b"), c = tree.child(a, "c");
+  tree.nodes[a].inclusive = tree.nodes[c].inclusive = std::chrono::milliseconds(1);
+  std::ostringstream out;
+  tree.writeFolded(out, "p");
+  check(out.str() == "p;a,b;c 1000000\n", "folded lines of a tree");
+}
+
+/// Compensates a recursive call tree, the overhead of the inner f is part of the outer one
+void testcompensation() {
+  using std::chrono::microseconds;
+  RankData data;
+  data.transitionCost = 1000;
+  auto & nodes = data.callTree.nodes;
+  int const outer = data.callTree.child(0, "f");
+  int const inner = data.callTree.child(outer, "f");
+  int const leaf = data.callTree.child(inner, "g");
+  nodes[outer].inclusive = microseconds(100);
+  nodes[inner].inclusive = microseconds(50);
+  nodes[leaf].inclusive = microseconds(10);
+  for (int n : {outer, inner, leaf})
+    nodes[n].transitions = 2;
+  data.evData.emplace("f", EventData("f")).first->second.total = microseconds(150);
+  data.evData.emplace("g", EventData("g")).first->second.total = microseconds(10);
+
+  data.compensateOverhead();
+  data.compensateOverhead(); // Does nothing
+  check(data.compensated, "compensated");
+  check(nodes[outer].inclusive == microseconds(94) and nodes[inner].inclusive == microseconds(46)
+        and nodes[leaf].inclusive == microseconds(8), "compensated inclusive times");
+  check(data.evData.at("f").total == microseconds(144), "recursive event compensated once");
+  check(data.evData.at("g").total == microseconds(8), "compensated total");
+}
+
+/// Runs frequent and short events, the records are replayed with the settings, so they are flushed before resetting them
+void testthrottling() {
+  auto & registry = EventRegistry::instance();
+  registry.throttleRate = 1;
+  for (int i = 0; i < 1100; ++i)
+    Event("throttled");
+  registry.flush();
+  registry.stateChangeThreshold = std::chrono::hours(1);
+  for (int i = 0; i < 10; ++i)
+    Event("short");
+  registry.flush();
+  registry.throttleRate = 0;
+  registry.stateChangeThreshold = std::chrono::seconds(0);
+}
+
+void checkthrottling(RankData const & data) {
+  // The rate is checked from throttleMinimum state changes on, i.e., from the start of run 501
+  auto const & throttled = data.evData.at("throttled");
+  check(throttled.throttled, "frequent event throttled");
+  check(throttled.stateChanges.size() == EventRegistry::throttleMinimum, "state changes before throttling");
+  check(throttled.getCount() == 1100 and throttled.untraced == 600, "throttled runs counted");
+
+  auto const & shortRuns = data.evData.at("short");
+  check(shortRuns.stateChanges.empty() and not shortRuns.throttled, "short runs dropped");
+  check(shortRuns.getCount() == 10 and shortRuns.untraced == 10, "short runs counted");
+}
+
+/// Checks, that the timeline has all state changes of data in order of time
+void checktimeline(RankData const & data, std::string const & what) {
+  auto const timeline = data.timeline();
+  size_t stateChanges = 0;
+  for (auto const & e : data.evData)
+    stateChanges += e.second.stateChanges.size();
+  check(timeline.size() == stateChanges, what + " has all state changes");
+  for (size_t i = 1; i < timeline.size(); ++i)
+    if (timeline[i].time < timeline[i - 1].time) {
+      check(false, what + " ordered by time");
+      break;
+    }
+}
+
+/// The state changes of x interleave, as if they were recorded by two threads
+void testtimeline() {
+  auto at = [](int ticks) { return Event::Clock::time_point(Event::Clock::duration(ticks)); };
+  RankData data;
+  auto & x = data.evData.emplace("x", EventData("x")).first->second.stateChanges;
+  auto & y = data.evData.emplace("y", EventData("y")).first->second.stateChanges;
+  x = {{Event::State::STARTED, at(1)}, {Event::State::STOPPED, at(5)},
+       {Event::State::STARTED, at(3)}, {Event::State::STOPPED, at(7)}};
+  y = {{Event::State::STARTED, at(2)}, {Event::State::STOPPED, at(4)}};
+  checktimeline(data, "timeline of interleaved state changes");
+  auto const timeline = data.timeline();
+  check(timeline.size() == 6 and timeline[1].event->getName() == "y" and timeline[5].time == at(7),
+        "merged timeline");
+}
+
+/// Downsamples a counter, each sample must average the same number of values
+void testcounter() {
+  Counter counter("downsampled", 2);
+  for (int i = 1; i <= 4; ++i)
+    counter.record(i);
+  auto const series = counter.getSeries();
+  check(series.values == std::vector<double>({1.5, 3.5}), "downsampled counter");
+  counter.record(5);
+  check(counter.getSeries().values.back() == 5, "pending sample of a counter");
+}
+
+/// Filters a long-lived event, it is not recorded from its next start on, until the filter is removed
+void testfilter() {
+  Event e("filtered", false, false);
+  for (auto exclude : {"", "^filtered$", ""}) {
+    EventRegistry::instance().setFilter("", exclude);
+    e.start();
+    e.stop();
+  }
+}
+
 int main(int argc, char *argv[])
 {
   MPI_Init(&argc, &argv);
@@ -91,8 +344,33 @@ int main(int argc, char *argv[])
   // testevents();
 
   Event("Anothertestevent");
-  
+  EventRegistry::instance().addProbe(makePerfCounterProbe());
+  EventRegistry::instance().addProbe(makeCPUTimeProbe());
+  EventRegistry::instance().addProbe(makeMemoryProbe());
+  EventRegistry::instance().startSampling(std::chrono::milliseconds(1));
+  testnesting();
+  testcalltree();
+  testthrottling();
+  testfilter();
+
+  EventRegistry::instance().compensateOverhead = true;
+
+  std::vector<RankData> results;
+  EventRegistry::instance().addSink(std::unique_ptr<Sink>(new ResultSink(results)));
   EventRegistry::instance().finalize();
   EventRegistry::instance().printAll();
+  if (not results.empty()) { // Only at rank 0
+    checkcalltree(results.front());
+    checkfolded(results);
+    checkthrottling(results.front());
+    check(results.front().evData.at("filtered").getCount() == 2, "filter applies to a long-lived event");
+    check(results.front().compensated, "compensated on finalize");
+    for (auto const & rank : results)
+      checktimeline(rank, "timeline of a rank");
+  }
+  testtimeline();
+  testcounter();
+  testcompensation();
   MPI_Finalize();
+  return failures == 0 ? 0 : 1;
 }
@@ -0,0 +1,168 @@
+// Queries the intervals of a binary event log by time range and compares them to a brute force search.
+// Long intervals span many checkpoints of the indices, so the open intervals of the checkpoints are tested.
+// Runs of an event on several threads are paired per thread.
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "EventTimings/EventUtils.hpp"
+#include "EventTimings/LogReader.hpp"
+
+using namespace EventTimings;
+
+int failures = 0;
+
+void check(bool condition, std::string const & what)
+{
+  if (not condition) {
+    std::cerr << "Failed: " << what << std::endl;
+    failures++;
+  }
+}
+
+/// Runs of an event, as start and stop in ticks
+using Runs = std::vector<std::pair<std::int64_t, std::int64_t>>;
+
+/// Returns the state changes of runs, that do not overlap, some of them end by a pause
+Event::StateChanges toStateChanges(Runs const & runs, std::mt19937 & random)
+{
+  Event::StateChanges stateChanges;
+  for (auto const & run : runs) {
+    stateChanges.emplace_back(Event::State::STARTED, Event::Clock::time_point(Event::Clock::duration(run.first)));
+    auto const end = random() % 4 == 0 ? Event::State::PAUSED : Event::State::STOPPED;
+    stateChanges.emplace_back(end, Event::Clock::time_point(Event::Clock::duration(run.second)));
+  }
+  return stateChanges;
+}
+
+/// Returns the intervals of a view, as pointers into the mapped log like the results of queries
+std::vector<binary::Interval const *> pointers(binary::View<binary::Interval> intervals)
+{
+  std::vector<binary::Interval const *> result;
+  for (auto const & interval : intervals)
+    result.push_back(&interval);
+  return result;
+}
+
+/// Compares the result of a query to the intervals of all, that overlap [from, to]
+void compare(std::vector<binary::Interval const *> found, std::vector<binary::Interval const *> const & all,
+             std::int64_t from, std::int64_t to, std::string const & what)
+{
+  std::string const query = what + " [" + std::to_string(from) + ", " + std::to_string(to) + "]";
+  for (size_t i = 1; i < found.size(); ++i)
+    check(found[i - 1]->start <= found[i]->start, query + " sorted by start");
+
+  std::vector<binary::Interval const *> expected;
+  for (auto interval : all)
+    if (interval->stop >= from and interval->start <= to)
+      expected.push_back(interval);
+  std::sort(expected.begin(), expected.end());
+  std::sort(found.begin(), found.end());
+  check(found == expected, query + " found " + std::to_string(found.size()) + " instead of "
+        + std::to_string(expected.size()) + " intervals");
+}
+
+int main()
+{
+  std::mt19937 random(42);
+  std::int64_t const t0 = 1000000000;
+
+  RankData data;
+  data.initialize(std::chrono::system_clock::time_point(std::chrono::seconds(1600000000)),
+                  Event::Clock::time_point(Event::Clock::duration(t0)));
+
+  // Short runs of several events, on a coarse grid, so that starts and stops coincide
+  std::map<std::string, Runs> runs;
+  std::int64_t end = t0;
+  for (auto const & name : {"a", "b", "c", "d"}) {
+    auto & r = runs[name];
+    std::int64_t time = t0;
+    while (r.size() < 400) {
+      time += 10 * (random() % 20);
+      auto const stop = time + 10 * (1 + random() % 30);
+      r.emplace_back(time, stop);
+      time = stop;
+    }
+    end = std::max(end, time);
+  }
+  // Long runs, that span many checkpoints, including one over the whole log and one, that is not stopped
+  runs["long"] = {{t0, end}};
+  runs["medium"] = {{t0 + (end - t0) / 5, t0 + (end - t0) / 2}, {t0 + (end - t0) / 2, t0 + 3 * (end - t0) / 4}};
+  for (auto const & r : runs)
+    data.addEventData(EventData(r.first, r.second.size(), 0, 0, 0, {}, toStateChanges(r.second, random)));
+  data.addEventData(EventData("unfinished", 1, 0, 0, 0, {},
+                              {{Event::State::STARTED, Event::Clock::time_point(Event::Clock::duration(t0 + 5))}}));
+  runs["unfinished"] = {{t0 + 5, end + 100}};
+  // Concurrent runs on two threads, each closed by the next pause or stop of its own thread
+  auto const at = [&](std::int64_t ticks) { return Event::Clock::time_point(Event::Clock::duration(t0 + ticks)); };
+  EventData threaded("threaded", 2, 0, 0, 0, {},
+                     {{Event::State::STARTED, at(10)}, {Event::State::STARTED, at(20)}, {Event::State::STOPPED, at(30)},
+                      {Event::State::PAUSED, at(40)}, {Event::State::STARTED, at(45)}, {Event::State::STOPPED, at(50)},
+                      {Event::State::STOPPED, at(60)}});
+  threaded.stateChangeThreads = {0, 1, 0, 1, 0, 1, 0};
+  data.addEventData(threaded);
+  runs["threaded"] = {{t0 + 10, t0 + 30}, {t0 + 20, t0 + 40}, {t0 + 45, t0 + 60}};
+  data.finalize(data.initializedAt + std::chrono::nanoseconds(end + 100 - t0),
+                Event::Clock::time_point(Event::Clock::duration(end + 100)));
+
+  std::string const file = "testintervals.bin";
+  {
+    std::ofstream out(file, std::ios::binary);
+    writeBinaryLog(out, data, 0);
+  }
+  binary::Log log(file);
+  check(log.isOpen(), "open: " + log.getError());
+  if (not log.isOpen())
+    return 1;
+  auto const & block = log[0];
+  std::vector<binary::Interval const *> all;
+  for (auto const & event : block.events())
+    for (auto interval : pointers(block.intervals(event)))
+      all.push_back(interval);
+
+  // The intervals of each event are its runs, sorted by start
+  for (auto const & r : runs) {
+    auto const event = block.event(r.first);
+    check(event != nullptr, "event " + r.first);
+    if (not event)
+      continue;
+    auto const intervals = block.intervals(*event);
+    bool equal = intervals.size() == r.second.size();
+    for (size_t i = 0; equal and i < intervals.size(); ++i)
+      equal = intervals[i].start == r.second[i].first and intervals[i].stop == r.second[i].second;
+    check(equal, "intervals of " + r.first);
+  }
+
+  // The long run is open at many checkpoints of the timeline
+  check(all.size() > 10 * binary::checkpointInterval, "intervals span several checkpoints");
+
+  // Ranges at random, empty ones, points and ranges, that begin or end at a start or stop
+  std::vector<std::pair<std::int64_t, std::int64_t>> queries{
+    {t0 - 100, t0 - 1}, {end + 200, end + 300}, {t0 - 100, end + 300}, {t0, t0}, {end, end}, {end + 100, end + 100}};
+  std::uniform_int_distribution<std::int64_t> times(t0 - 50, end + 150);
+  for (int q = 0; q < 300; ++q) {
+    auto from = times(random), to = times(random);
+    if (from > to)
+      std::swap(from, to);
+    queries.emplace_back(from, to);
+    queries.emplace_back(from, from);
+    auto const interval = all[random() % all.size()];
+    queries.emplace_back(interval->start, interval->start + 10 * (random() % 50));
+    queries.emplace_back(interval->stop, interval->stop);
+  }
+
+  for (auto const & q : queries) {
+    compare(block.intervals(q.first, q.second), all, q.first, q.second, "timeline");
+    for (auto const & event : block.events())
+      compare(block.intervals(event, q.first, q.second), pointers(block.intervals(event)), q.first, q.second,
+              "event " + block.string(event.name).str());
+  }
+
+  if (failures == 0)
+    std::cout << "Interval queries of " << queries.size() << " ranges passed" << std::endl;
+  return failures == 0 ? 0 : 1;
+}